@@ -17,6 +17,7 @@ to explore
 #include "midi.hpp"
 
 #include "pitchgrid_exquis.hpp"
+#include "glide.hpp"
 #include "datalink.hpp"
 
 #include "exquis_display.hpp"
@@ -78,7 +79,6 @@ struct MicroExquis : Module {
 
 	ConsistentTuning tuning = ConsistentTuning({2, 5}, 2.f, {1, 3}, pow(2.f, 7.f/12.f)); // 12TET
 
-	rack::dsp::Timer timer;
 	int cnt = 0;
 	PitchGridExquis exquis;
 
@@ -128,6 +128,9 @@ struct MicroExquis : Module {
 
 	TuningDataSender tuningDataSender = TuningDataSender();
 
+	// Portamento towards the tuned output, either in a fixed time per note or in a fixed time per period
+	GlideProcessor glide;
+
     
 
 	MicroExquis() {
@@ -155,7 +158,6 @@ struct MicroExquis : Module {
 		//TuningDataSender tuningDataSender(&outputs[TUNING_DATA_OUTPUT]);
 		tuningDataSender.addTuningData(&tuning, &exquis.scaleMapper.scale);
 
-		timer.reset();
 		lightDivider.setDivision(16);
 		badlyImplementedValueUpdateDividerTODOMakeProperly.setDivision(24000);
 
@@ -197,6 +199,8 @@ struct MicroExquis : Module {
 		else{
 			INFO("Exquis not found.");
 		}
+		// Hot-plug detection from here on, the audio thread only reads its result
+		exquis.deviceWatcher.start();
 
 	}
 
@@ -400,24 +404,9 @@ struct MicroExquis : Module {
 		//
 		//}
 
-		// check 
-		float dt = timer.process(args.sampleTime);
-		if (exquis.connected){
-			// check if connection is alive every 5 seconds
-			if (dt > 5.f){
-				timer.reset();
-				exquis.checkConnection();
-			}
-		}else{
-			// if disconnected, check for exquis every 2 seconds
-			if (dt > 2.f){
-				timer.reset();
-				exquis.checkConnection();
-				if (exquis.connected){
-					exquis.initialize();
-
-				}
-			}
+		// pick up hot-plugged Exquis from the background device watcher
+		if (exquis.pollConnection()){
+			exquis.initialize();
 		}
 
 		exquis.process(args);
@@ -431,6 +420,10 @@ struct MicroExquis : Module {
 				ExquisNote* note = exquis.getNoteByVoltage(pitch[i]);
 				voltage[i] = tuning.vecToVoltage(note->scaleCoord);
 			}
+			if (glide.isEnabled()) {
+				float period = tuning.vecToVoltageNoOffset(exquis.scaleMapper.scale.scale_system);
+				voltage = glide.process(c / 4, voltage, period, args.sampleTime);
+			}
 
 			// Set output
 			if (outputs[MVOCT_OUTPUT].isConnected()){
@@ -540,6 +533,8 @@ struct MicroExquis : Module {
 		json_object_set_new(layoutJ, "interval1", layoutInterval1J);
 		json_object_set_new(layoutJ, "interval2", layoutInterval2J);
 
+		glide.dataToJson(rootJ);
+
 		return rootJ;
 	}
 
@@ -624,6 +619,7 @@ struct MicroExquis : Module {
 				INFO("Layout loaded: %d %d %d %d %d %d", baseX, baseY, interval1X, interval1Y, interval2X, interval2Y);
 			}
 		}
+		glide.dataFromJson(rootJ);
 		exquis.showAllOctavesLayer();
 	}
 };
@@ -787,8 +783,8 @@ struct ExquisHexDisplay : Widget {
 	}
 
 	void setHSLFillColor(const DrawArgs& args, int noteSeqNr, bool bright){
-		double r, g, b;
-		hsluv2rgb(360*posfmod(noteSeqNr/7.f + .106f, 1.f), 100.0, bright?70.0:30.0, &r, &g, &b);
+		float r, g, b;
+		getHsluvPalette().get(360*posfmod(noteSeqNr/7.f + .106f, 1.f), bright ? HsluvPalette::LIGHTNESS_BRIGHT : HsluvPalette::LIGHTNESS_DARK, &r, &g, &b);
 		nvgFillColor(args.vg, nvgRGB(127+127*r, 127+127*g, 127+127*b));
 	}
 	void drawScalePath(const DrawArgs& args){
@@ -866,6 +862,14 @@ struct MicroExquisWidget : ModuleWidget {
 
 	}
 
+	void appendContextMenu(Menu* menu) override {
+		MicroExquis* module = getModule<MicroExquis>();
+		assert(module);
+
+		menu->addChild(new MenuSeparator);
+		module->glide.appendContextMenu(menu);
+	}
+
 };
 
 
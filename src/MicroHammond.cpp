@@ -1,6 +1,8 @@
 #include "plugin.hpp"
 #include "pitchgrid.hpp"
 #include "datalink.hpp"
+#include "hammond_kernels.hpp"
+#include "hammond_wavetable.hpp"
 
 using simd::float_4;
 
@@ -19,107 +21,336 @@ T sin2pi_pade_05_5_4(T x) {
 	       / (1 + T(1.296008659) * simd::pow(x, 2) + T(0.7028072946) * simd::pow(x, 4));
 }
 
+// Quadratic approximation of sine, slightly richer harmonics
+template <typename T>
+T sin2pi_quadratic(T phase) {
+	T halfPhase = (phase < 0.5f);
+	T x = phase - simd::ifelse(halfPhase, 0.25f, 0.75f);
+	T v = 1.f - 16.f * simd::pow(x, 2);
+	return v * simd::ifelse(halfPhase, 1.f, -1.f);
+}
+
+template <typename T>
+T sin2pi(SineShape shape, T phase) {
+	switch (shape) {
+		case SineShape::QUADRATIC: return sin2pi_quadratic(phase);
+		case SineShape::PADE_7_6: return sin2pi_pade_05_7_6(phase);
+		default: return sin2pi_pade_05_5_4(phase);
+	}
+}
+
 template <typename T>
 T expCurve(T x) {
 	return (3 + x * (-13 + 5 * x)) / (3 + 2 * x);
 }
 
 
+const int NUM_DRAWBARS = 9;
+const int MAX_PARTIALS = 64;
+// Partials quieter than this (relative to full drawbar) are not rendered
+const float PARTIAL_AMP_THRESHOLD = 1e-3f;
+
+
+// Bank of sine partials for a group of four voices, stored as structure of arrays.
+// All partials of a voice share the voice's sync input, so sync is detected once per sample.
 template <int OVERSAMPLE, int QUALITY, typename T>
-struct VoltageControlledSinOsc {
-	bool analog = false;
+struct VoltageControlledSinBank {
+	SineShape shape = SineShape::QUADRATIC;
 	bool soft = false;
 	bool syncEnabled = false;
+	// Without minBLEP correction hard sync aliases, but is cheaper
+	bool minBlep = true;
+	// Vector width of the kernel used for partials without sync, see getPartialKernelWidth()
+	int kernelWidth = 4;
 	// For optimizing in serial code
 	int channels = 0;
 
 	T lastSyncValue = 0.f;
-	T phase = 0.f;
-	T freq = 0.f;
 	T syncDirection = 1.f;
 
-	dsp::TRCFilter<T> sqrFilter;
-
-	dsp::MinBlepGenerator<QUALITY, OVERSAMPLE, T> sinMinBlep;
-
-	T sinValue = 0.f;
-
-	void process(float deltaTime, T syncValue) {
-		// Advance phase
-		T deltaPhase = simd::clamp(freq * deltaTime, 0.f, 0.35f);
-		if (soft) {
-			// Reverse direction
-			deltaPhase *= syncDirection;
-		}
-		else {
-			// Reset back to forward
+	T phase[MAX_PARTIALS] = {};
+	T freq[MAX_PARTIALS] = {};
+	// Per-sample increments, for linear interpolation between control blocks
+	T freqStep[MAX_PARTIALS] = {};
+	// Per-voice amplitudes, zero in lanes where the partial is culled
+	T amp[MAX_PARTIALS] = {};
+	T ampStep[MAX_PARTIALS] = {};
+	// Key click added to every partial, too short for the linear ramps, so it decays by a factor per sample
+	bool clickActive = false;
+	T click = 0.f;
+	T clickDecay = 1.f;
+	T clickGain[MAX_PARTIALS] = {};
+
+	// All partials of a voice jump at the same sync crossing, so one minBLEP per voice corrects their weighted sum
+	dsp::MinBlepGenerator<QUALITY, OVERSAMPLE, T> syncMinBlep;
+
+	// Indices of partials that are audible in at least one lane, set at control rate
+	int activePartials[MAX_PARTIALS];
+	int numActive = 0;
+
+	T process(float deltaTime, T syncValue) {
+		if (!soft || !syncEnabled) {
+			// Reset back to forward, also once the sync cable is removed after a soft-sync reversal
 			syncDirection = 1.f;
 		}
-		phase += deltaPhase;
-		// Wrap phase
-		phase -= simd::floor(phase);
-
+		// Track the sync input on every path, so enabling sync or leaving the wide kernels does not see a stale
+		// value and fire a spurious crossing
+		T prevSyncValue = lastSyncValue;
+		lastSyncValue = syncValue;
+
+		// Without sync the partials are independent and can be rendered several at a time
+		if (kernelWidth > 4 && !syncEnabled && !clickActive) {
+			if (kernelWidth == 16)
+				return renderPartials16(phase, freq, freqStep, amp, ampStep, activePartials, numActive, deltaTime, shape);
+			return renderPartials8(phase, freq, freqStep, amp, ampStep, activePartials, numActive, deltaTime, shape);
+		}
 
 		// Detect sync
 		// Might be NAN or outside of [0, 1) range
+		T sync = 0.f;
+		T syncCrossing = 0.f;
+		int syncMask = 0;
 		if (syncEnabled) {
-			T deltaSync = syncValue - lastSyncValue;
-			T syncCrossing = -lastSyncValue / deltaSync;
-			lastSyncValue = syncValue;
-			T sync = (0.f < syncCrossing) & (syncCrossing <= 1.f) & (syncValue >= 0.f);
-			int syncMask = simd::movemask(sync);
-			if (syncMask) {
-				if (soft) {
-					syncDirection = simd::ifelse(sync, -syncDirection, syncDirection);
+			T deltaSync = syncValue - prevSyncValue;
+			syncCrossing = -prevSyncValue / deltaSync;
+			sync = (0.f < syncCrossing) & (syncCrossing <= 1.f) & (syncValue >= 0.f);
+			syncMask = simd::movemask(sync);
+		}
+
+		T out = 0.f;
+		T syncJump = 0.f;
+		for (int i = 0; i < numActive; i++) {
+			int p = activePartials[i];
+
+			// Advance phase
+			T deltaPhase = simd::clamp(freq[p] * deltaTime, 0.f, 0.35f);
+			if (soft) {
+				// Reverse direction
+				deltaPhase *= syncDirection;
+			}
+			phase[p] += deltaPhase;
+			// Wrap phase
+			phase[p] -= simd::floor(phase[p]);
+
+			T a = amp[p];
+			if (clickActive)
+				a += click * clickGain[p];
+
+			if (syncMask && !soft) {
+				T newPhase = simd::ifelse(sync, (1.f - syncCrossing) * deltaPhase, phase[p]);
+				if (minBlep) {
+					syncJump += a * (sin(newPhase) - sin(phase[p]));
 				}
-				else {
-					T newPhase = simd::ifelse(sync, (1.f - syncCrossing) * deltaPhase, phase);
-					// Insert minBLEP for sync
-					for (int i = 0; i < channels; i++) {
-						if (syncMask & (1 << i)) {
-							T mask = simd::movemaskInverse<T>(1 << i);
-							float p = syncCrossing[i] - 1.f;
-							T x;
-							x = mask & (sin(newPhase) - sin(phase));
-							sinMinBlep.insertDiscontinuity(p, x);
-						}
-					}
-					phase = newPhase;
+				phase[p] = newPhase;
+			}
+
+			// Sin
+			out += a * sin(phase[p]);
+
+			freq[p] += freqStep[p];
+			amp[p] += ampStep[p];
+		}
+
+		if (syncMask && !soft && minBlep) {
+			// Insert minBLEP for sync
+			for (int c = 0; c < channels; c++) {
+				if (syncMask & (1 << c)) {
+					T mask = simd::movemaskInverse<T>(1 << c);
+					float x = syncCrossing[c] - 1.f;
+					syncMinBlep.insertDiscontinuity(x, mask & syncJump);
 				}
 			}
 		}
+		if (syncEnabled && minBlep) {
+			out += syncMinBlep.process();
+		}
+		if (syncMask && soft) {
+			syncDirection = simd::ifelse(sync, -syncDirection, syncDirection);
+		}
+		if (clickActive)
+			click *= clickDecay;
+		return out;
+	}
 
+	T sin(T phase) {
+		return sin2pi(shape, phase);
+	}
 
-		// Sin
-		sinValue = sin(phase);
-		sinValue += sinMinBlep.process();
+	T light(int p) {
+		return simd::sin(2 * T(M_PI) * phase[p]);
 	}
+};
 
-	T sin(T phase) {
-		T v;
-		if (analog) {
-			// Quadratic approximation of sine, slightly richer harmonics
-			T halfPhase = (phase < 0.5f);
-			T x = phase - simd::ifelse(halfPhase, 0.25f, 0.75f);
-			v = 1.f - 16.f * simd::pow(x, 2);
-			v *= simd::ifelse(halfPhase, 1.f, -1.f);
+
+// Half-band lowpass and 2:1 decimation in polyphase form. Every other tap of a half-band filter is zero,
+// so the even input samples go through a FIR of the nonzero taps and the odd ones only through a delay.
+template <typename T>
+struct HalfBandDecimator {
+	// Nonzero taps on each side of the center tap, giving a filter of 4 * TAPS - 1 taps
+	static const int TAPS = 8;
+
+	float coeffs[2 * TAPS];
+	// Stored twice so the newest samples can be read as one contiguous window
+	T even[4 * TAPS] = {};
+	// The odd samples are delayed to line up with the center tap
+	T odd[TAPS - 1] = {};
+	int evenPos = 0;
+	int oddPos = 0;
+
+	HalfBandDecimator() {
+		// Blackman windowed sinc with cutoff at half the output Nyquist frequency
+		const int length = 4 * TAPS - 1;
+		const int center = 2 * TAPS - 1;
+		float sum = 0.f;
+		for (int i = 0; i < 2 * TAPS; i++) {
+			int j = 2 * i;
+			float x = (j - center) / 2.f;
+			float window = 0.42f - 0.5f * std::cos(2 * M_PI * j / (length - 1)) + 0.08f * std::cos(4 * M_PI * j / (length - 1));
+			coeffs[i] = std::sin(M_PI * x) / (M_PI * x) * window;
+			sum += coeffs[i];
 		}
-		else {
-			v = sin2pi_pade_05_5_4(phase);
-			// v = sin2pi_pade_05_7_6(phase);
-			// v = simd::sin(2 * T(M_PI) * phase);
+		// The center tap contributes the other half of the DC gain
+		for (int i = 0; i < 2 * TAPS; i++) {
+			coeffs[i] *= 0.5f / sum;
 		}
-		return v;
 	}
-	T sin() {
-		return sinValue;
+
+	void reset() {
+		for (T& x : even)
+			x = 0.f;
+		for (T& x : odd)
+			x = 0.f;
 	}
 
-	T light() {
-		return simd::sin(2 * T(M_PI) * phase);
+	// Takes two consecutive input samples, oldest first
+	T process(const T* in) {
+		evenPos = (evenPos + 1) % (2 * TAPS);
+		even[evenPos] = even[evenPos + 2 * TAPS] = in[1];
+		T delayed = odd[oddPos];
+		odd[oddPos] = in[0];
+		oddPos = (oddPos + 1) % (TAPS - 1);
+
+		// even[evenPos + 2 * TAPS - i] is the input i pairs ago
+		const T* window = &even[evenPos + 1];
+		T out = 0.5f * delayed;
+		for (int i = 0; i < 2 * TAPS; i++) {
+			out += coeffs[2 * TAPS - 1 - i] * window[i];
+		}
+		return out;
 	}
 };
 
+// 2x or 4x decimation by one or two half-band stages
+template <typename T>
+struct OversamplingDecimator {
+	HalfBandDecimator<T> stage1;
+	HalfBandDecimator<T> stage2;
+
+	void reset() {
+		stage1.reset();
+		stage2.reset();
+	}
+
+	T process(int oversample, const T* in) {
+		if (oversample == 4) {
+			T half[2] = {stage1.process(&in[0]), stage1.process(&in[2])};
+			return stage2.process(half);
+		}
+		if (oversample == 2) {
+			return stage1.process(in);
+		}
+		return in[0];
+	}
+};
+
+
+const int MAX_TONEWHEELS = 256;
+const int TONEWHEEL_TABLE_SIZE = 1024;
+
+// Sine oscillators shared by all voices, one per lattice coordinate, like the tonewheels of a Hammond organ.
+// Rebuilt once per control block; wheels that are still in use keep their phase.
+struct LatticeTonewheelBank {
+	// Index of an always silent wheel output, for partials above Nyquist
+	static const int SILENT_WHEEL = MAX_TONEWHEELS;
+
+	SineShape shape = SineShape::QUADRATIC;
+	int numWheels = 0;
+	bool overflow = false;
+
+	// Double buffered so phases can be carried over from the previous block
+	int current = 0;
+	ScaleVector coords[2][MAX_TONEWHEELS];
+	float_4 phase[2][MAX_TONEWHEELS / 4] = {};
+	float_4 deltaPhase[MAX_TONEWHEELS / 4] = {};
+	// Open addressing table from lattice coordinate to wheel index + 1
+	int16_t table[2][TONEWHEEL_TABLE_SIZE] = {};
+
+	alignas(16) float out[MAX_TONEWHEELS + 4] = {};
+
+	static int hash(ScaleVector c) {
+		return (c.x * 73856093 ^ c.y * 19349663) & (TONEWHEEL_TABLE_SIZE - 1);
+	}
+
+	void beginUpdate() {
+		current ^= 1;
+		numWheels = 0;
+		overflow = false;
+		std::memset(table[current], 0, sizeof(table[current]));
+		std::memset(deltaPhase, 0, sizeof(deltaPhase));
+	}
+
+	int lookup(int buffer, ScaleVector c, int* slot) {
+		int h = hash(c);
+		while (table[buffer][h]) {
+			if (coords[buffer][table[buffer][h] - 1] == c)
+				break;
+			h = (h + 1) & (TONEWHEEL_TABLE_SIZE - 1);
+		}
+		*slot = h;
+		return table[buffer][h];
+	}
+
+	// Returns the wheel for a lattice coordinate, allocating it with the frequency given by freqForCoord
+	template <typename F>
+	int getWheel(ScaleVector c, float sampleTime, F freqForCoord) {
+		int slot;
+		int entry = lookup(current, c, &slot);
+		if (entry > 0)
+			return entry - 1;
+		float freq = freqForCoord(c);
+		if (freq * sampleTime >= 0.5f)
+			return SILENT_WHEEL;
+		if (numWheels >= MAX_TONEWHEELS) {
+			overflow = true;
+			return SILENT_WHEEL;
+		}
+		int w = numWheels++;
+		coords[current][w] = c;
+		table[current][slot] = w + 1;
+
+		int oldSlot;
+		int oldEntry = lookup(current ^ 1, c, &oldSlot);
+		phase[current][w / 4][w % 4] = oldEntry > 0 ? phase[current ^ 1][(oldEntry - 1) / 4][(oldEntry - 1) % 4] : 0.f;
+		deltaPhase[w / 4][w % 4] = freq * sampleTime;
+		return w;
+	}
+
+	void process() {
+		for (int g = 0; g < (numWheels + 3) / 4; g++) {
+			float_4& p = phase[current][g];
+			p += deltaPhase[g];
+			p -= simd::floor(p);
+			float_4 v = sin2pi(shape, p);
+			v.store(&out[4 * g]);
+		}
+	}
+
+	float light(int w) {
+		if (w >= numWheels)
+			return 0.f;
+		return std::sin(2 * M_PI * phase[current][w / 4][w % 4]);
+	}
+};
 
 
 //class ConsistentTuning {
@@ -150,7 +381,84 @@ struct VoltageControlledSinOsc {
 //	};
 //};
 
-const int NUM_OSCILLATORS = 9;
+// Params, pitch and partial frequencies are evaluated once per block and linearly interpolated in between
+const int CONTROL_BLOCK_SIZE = 16;
+
+// CV expander inputs: one per drawbar, then spectral tilt
+const int NUM_EXPANDER_CVS = NUM_DRAWBARS + 1;
+const int TILT_CV = NUM_DRAWBARS;
+// Change of a drawbar level within one control block above which CVs are applied per sample
+const float CV_AUDIO_RATE_THRESHOLD = 0.01f;
+// Crossfade length when a rebuilt wavetable replaces the current one
+const int WAVETABLE_FADE_SAMPLES = 256;
+// Percussion and key click envelopes: decay time constants in seconds and peak partial amplitudes
+const float PERCUSSION_FAST_DECAY = 0.1f;
+const float PERCUSSION_SLOW_DECAY = 0.4f;
+const float PERCUSSION_LEVEL = 1.f;
+const float KEY_CLICK_DECAY = 0.002f;
+const float KEY_CLICK_LEVEL = 0.3f;
+
+// Written by the CV expander into the MicroHammond on its left
+struct VCOMHExpanderMessage {
+	bool connected[NUM_EXPANDER_CVS] = {};
+	float voltages[NUM_EXPANDER_CVS][16] = {};
+};
+
+
+// Measures the module's own processing time and asks for a lower quality tier while it exceeds the budget.
+// Only one control block out of every MEASURE_INTERVAL is timed, to keep the overhead of the clock low.
+struct QualityGovernor {
+	static const int MEASURE_INTERVAL = 8;
+	// Number of timed samples per load estimate
+	static const int WINDOW_SAMPLES = 256;
+	// Consecutive estimates with plenty of headroom before stepping back up, about a second at 48 kHz
+	static const int HEADROOM_WINDOWS = 24;
+
+	// Fraction of the sample period, 0 disables the governor
+	float budget = 0.f;
+	float load = 0.f;
+	bool measuring = false;
+	int blockCounter = 0;
+	double measuredTime = 0.;
+	int measuredSamples = 0;
+	int headroomWindows = 0;
+
+	void reset() {
+		measuring = false;
+		measuredTime = 0.;
+		measuredSamples = 0;
+		headroomWindows = 0;
+	}
+
+	void beginBlock() {
+		measuring = budget > 0.f && ++blockCounter % MEASURE_INTERVAL == 0;
+	}
+
+	// Returns -1 to step the tier down, 1 to step it up again, 0 to keep it
+	int addSample(double time, float sampleTime) {
+		measuredTime += time;
+		if (++measuredSamples < WINDOW_SAMPLES)
+			return 0;
+		load = measuredTime / (measuredSamples * sampleTime);
+		measuredTime = 0.;
+		measuredSamples = 0;
+		if (load > budget) {
+			headroomWindows = 0;
+			return -1;
+		}
+		// The next tier up costs roughly twice as much
+		if (load < budget * 0.4f) {
+			if (++headroomWindows >= HEADROOM_WINDOWS) {
+				headroomWindows = 0;
+				return 1;
+			}
+		}
+		else {
+			headroomWindows = 0;
+		}
+		return 0;
+	}
+};
 
 struct VCOMH : Module {
 	enum ParamIds {
@@ -186,6 +494,7 @@ struct VCOMH : Module {
 		FM_INPUT,
 		SYNC_INPUT,
 		TUNING_DATA_INPUT,
+		GATE_INPUT,
 		NUM_INPUTS
 	};
 	enum OutputIds {
@@ -199,8 +508,146 @@ struct VCOMH : Module {
 		NUM_LIGHTS
 	};
 
-	VoltageControlledSinOsc<16, 16, float_4> oscillators[4*NUM_OSCILLATORS];
+	VoltageControlledSinBank<16, 16, float_4> banks[4];
+	// The partials of each voice are summed at the oversampled rate and decimated once
+	OversamplingDecimator<float_4> decimators[4];
+	int oversample = 1;
+	int activeOversample = 1;
 	dsp::ClockDivider lightDivider;
+
+	// Control block state
+	int blockPos = 0;
+	int channels = 0;
+	bool linear = false;
+	bool soft = false;
+	// Evaluate FM per sample instead of per control block
+	bool audioRateFm = false;
+
+	enum class Quality : int {
+		QUALITY_ECO = 0,
+		QUALITY_STANDARD = 1,
+		QUALITY_HIGH = 2
+	};
+	// Selected tier, and the tier currently rendered, which the governor may lower
+	Quality quality = Quality::QUALITY_STANDARD;
+	Quality activeQuality = Quality::QUALITY_STANDARD;
+	// Sine approximation of each tier: quadratic, 5/4 Pade and 7/6 Pade
+	SineShape qualitySineShapes[3] = {SineShape::QUADRATIC, SineShape::PADE_5_4, SineShape::PADE_7_6};
+	// High renders sync at least this much oversampled, whatever the oversampling menu says
+	static const int HIGH_SYNC_OVERSAMPLE = 2;
+	QualityGovernor governor;
+	int cpuBudget = 0;
+
+	// Voices with a closed gate are not rendered once their hold time has passed,
+	// so that the release of a downstream envelope is not cut off
+	int gateHold = 2;
+	float voiceHoldTime[16] = {};
+	bool voiceActive[16] = {};
+	// Voices that were inactive in the previous control block restart from phase 0
+	bool voiceReactivated[16] = {};
+	// Voices rendered by the tonewheels in the previous control block
+	bool tonewheelVoiceActive[16] = {};
+
+	VCOMHExpanderMessage expanderMessages[2];
+	bool cvConnected = false;
+	// Per-voice drawbar levels at the last control block
+	float_4 cvDrawbars[4][NUM_DRAWBARS] = {};
+	// Banks whose drawbar CVs moved fast in the last block set partial amplitudes per sample,
+	// as the drawbar mix times a gain that ramps at control rate
+	bool cvAudioRate[4] = {};
+	float_4 cvGain[4][MAX_PARTIALS] = {};
+	float_4 cvGainStep[4][MAX_PARTIALS] = {};
+
+	// Percussion sounds one harmonic with a decaying envelope when a gate opens, like the Hammond
+	// percussion tab, and the key click briefly raises all partials
+	enum class Percussion : int {
+		PERCUSSION_OFF = 0,
+		PERCUSSION_SECOND = 1,
+		PERCUSSION_THIRD = 2
+	};
+	Percussion percussion = Percussion::PERCUSSION_OFF;
+	bool percussionSlow = false;
+	bool keyClick = false;
+	// Partial closest to the percussion harmonic, -1 if there is none
+	int percussionPartial = -1;
+	bool voiceGateHigh[16] = {};
+	// Time since the gate of each voice opened
+	float voiceEnvTime[16];
+	// Envelope amplitudes added to the drawbar mix, evaluated per control block and ramped in between
+	float_4 envAmp[4][MAX_PARTIALS] = {};
+	float_4 envAmpStep[4][MAX_PARTIALS] = {};
+
+	enum class PartialSets : int {
+		PARTIALS_DRAWBARS = 0,
+		PARTIALS_LATTICE_16 = 1,
+		PARTIALS_LATTICE_32 = 2,
+		PARTIALS_LATTICE_64 = 3
+	};
+	PartialSets partialSet = PartialSets::PARTIALS_DRAWBARS;
+
+	// Current partial set, relative to the fundamental
+	int numPartials = NUM_DRAWBARS;
+	int fundamentalPartial = 2;
+	float partialRelFreqs[MAX_PARTIALS] = {};
+	float partialAmps[MAX_PARTIALS] = {};
+	// Each partial amplitude is a weighted sum of at most two drawbars, so it can be recomputed per voice
+	int partialDrawbars[MAX_PARTIALS][2] = {};
+	float partialDrawbarWeights[MAX_PARTIALS][2] = {};
+	// Scales the sum of partials so that all drawbars at full level give the same peak in every partial set
+	float outputGain = 1.f / NUM_DRAWBARS;
+	float partialLog2RelFreqs[MAX_PARTIALS] = {};
+	ScaleVector partialCoords[MAX_PARTIALS];
+	bool partialsOnLattice = true;
+
+	// Lattice coordinates of the drawbars, relative to the fundamental
+	ScaleVector drawbarCoords[NUM_DRAWBARS] = {{-2, -5}, {1, 3}, {0, 0}, {2, 5}, {3, 8}, {4, 10}, {4, 12}, {5, 13}, {6, 15}};
+	bool drawbarsOnLattice = true;
+
+	// Reverse tuned harmonic series, rebuilt when the tuning changes
+	int numLatticePartials = 0;
+	float latticeRelFreqs[MAX_PARTIALS] = {};
+	float latticeLog2RelFreqs[MAX_PARTIALS] = {};
+	ScaleVector latticeCoords[MAX_PARTIALS];
+	bool latticeSpectrumDirty = true;
+
+	// Shared tonewheel mode: one oscillator per lattice coordinate, voices only mix amplitudes
+	bool tonewheels = false;
+	bool tonewheelsActive = false;
+	LatticeTonewheelBank tonewheelBank;
+	int numTonewheelPartials = 0;
+	int tonewheelPartials[MAX_PARTIALS];
+	float tonewheelAmps[MAX_PARTIALS] = {};
+	float tonewheelAmpSteps[MAX_PARTIALS] = {};
+	float voicePitches[16] = {};
+	ScaleVector voiceCoords[16];
+	ScaleVector prevVoiceCoords[16];
+	// Crossfade from the wheels of the previous note to the new one over a control block
+	bool voiceFading[16] = {};
+	float_4 voiceFade[4] = {};
+	bool voiceCoordsDirty = true;
+	int wheelIndices[MAX_PARTIALS][16] = {};
+	int prevWheelIndices[MAX_PARTIALS][16] = {};
+	// Wavetable mode: harmonic partial sets are baked into a mip-mapped table and played with one phase per voice
+	bool wavetable = false;
+	bool wavetableActive = false;
+	WavetableBuilder wavetableBuilder;
+	WavetableSpec wavetableSpec;
+	// Partial set the spec was derived from, and whether it fits a table at all
+	int wavetableNumPartials = -1;
+	float wavetableRelFreqs[MAX_PARTIALS] = {};
+	float wavetableAmps[MAX_PARTIALS] = {};
+	bool wavetableHarmonic = false;
+	bool wavetableSpecDirty = false;
+	float_4 wavetablePhase[4] = {};
+	float_4 wavetableFreq[4] = {};
+	float_4 wavetableFreqStep[4] = {};
+	float_4 wavetableGain[4] = {};
+	float_4 wavetableGainStep[4] = {};
+	int wavetableLevels[16] = {};
+	// The previous table keeps playing at its own phase during the crossfade
+	float_4 prevWavetablePhase[4] = {};
+	int prevWavetableLevels[16] = {};
+	float wavetableFade = 1.f;
 	dsp::ClockDivider onceASecDivider;
 
 	enum class TuningPresets : int {
@@ -256,12 +703,22 @@ struct VCOMH : Module {
 		configInput(FM_INPUT, "Frequency modulation");
 		configInput(SYNC_INPUT, "Sync");
 		configInput(TUNING_DATA_INPUT, "Tuning Data");
+		configInput(GATE_INPUT, "Gate");
 
 		configOutput(SIN_OUTPUT, "Sine");
 
 		lightDivider.setDivision(16);
 		onceASecDivider.setDivision(4800);
 
+		for (auto& bank : banks) {
+			bank.kernelWidth = getPartialKernelWidth();
+		}
+
+		std::fill(voiceEnvTime, voiceEnvTime + 16, INFINITY);
+
+		rightExpander.producerMessage = &expanderMessages[0];
+		rightExpander.consumerMessage = &expanderMessages[1];
+
 		tuningDataReceiver.initialize();
 
 
@@ -311,9 +768,13 @@ struct VCOMH : Module {
 			params[RELFREQ7_PARAM].setValue(5.f);
 			params[RELFREQ8_PARAM].setValue(6.f);
 			params[RELFREQ9_PARAM].setValue(8.f);			
+			drawbarsOnLattice = false;
 		}else{
 			int harm5_a = tuningPreset == TuningPresets::TUNING_THIRDCOMMA_MEANTONE ? 5 : 4;
 			int harm5_b = tuningPreset == TuningPresets::TUNING_THIRDCOMMA_MEANTONE ? 11 : 12;
+			ScaleVector coords[NUM_DRAWBARS] = {{-2, -5}, {1, 3}, {0, 0}, {2, 5}, {3, 8}, {4, 10}, {harm5_a, harm5_b}, {5, 13}, {6, 15}};
+			std::copy(coords, coords + NUM_DRAWBARS, drawbarCoords);
+			drawbarsOnLattice = true;
 			params[RELFREQ1_PARAM].setValue(tuning.vecToFreqRatio({-2, -5}));
 			params[RELFREQ2_PARAM].setValue(tuning.vecToFreqRatio({1, 3}));
 			params[RELFREQ4_PARAM].setValue(tuning.vecToFreqRatio({2, 5}));
@@ -323,77 +784,743 @@ struct VCOMH : Module {
 			params[RELFREQ8_PARAM].setValue(tuning.vecToFreqRatio({5, 13}));
 			params[RELFREQ9_PARAM].setValue(tuning.vecToFreqRatio({6, 15}));
 		}
+		latticeSpectrumDirty = true;
+		voiceCoordsDirty = true;
 	}
 
-	void process(const ProcessArgs& args) override {
+	int getPartialSet() {
+		return static_cast<int>(partialSet);
+	}
+	void setPartialSet(int p) {
+		partialSet = (PartialSets)p;
+		latticeSpectrumDirty = true;
+	}
+	// Called from the UI thread, the builder thread and its tables are only created when first needed
+	void setWavetable(bool enabled) {
+		if (enabled)
+			wavetableBuilder.start();
+		wavetable = enabled;
+	}
+	int getMaxLatticeHarmonic() {
+		switch (partialSet) {
+			case PartialSets::PARTIALS_LATTICE_16: return 16;
+			case PartialSets::PARTIALS_LATTICE_32: return 32;
+			case PartialSets::PARTIALS_LATTICE_64: return 64;
+			default: return 0;
+		}
+	}
+
+	// Closest lattice point to a pitch voltage, searching the scale notes and their single chromatic alterations
+	ScaleVector closestLatticePoint(float target, float* voltage) {
+		ScaleVector coord = {0, 0};
+		*voltage = 0.f;
+		float periodVoltage = tuning.vecToVoltageNoOffset(scale.scale_system);
+		if (periodVoltage <= 0.f)
+			return coord;
+
+		ScaleVector chroma = {1, -1};
+		int seqCenter = (int)roundf(target / periodVoltage * scale.n);
+		float bestError = INFINITY;
+		int bestRank = 0;
+		for (int seqNr = seqCenter - scale.n / 2 - 1; seqNr <= seqCenter + scale.n / 2 + 1; seqNr++) {
+			ScaleVector note = scale.scaleNoteSeqNrToCoord(seqNr);
+			for (int a = -1; a <= 1; a++) {
+				ScaleVector v = note + chroma * a;
+				float vVoltage = tuning.vecToVoltageNoOffset(v);
+				float error = fabsf(vVoltage - target);
+				// Among enharmonic equivalents prefer unaltered notes close to the expected scale degree
+				int rank = 100 * std::abs(a) + std::abs(seqNr - seqCenter);
+				if (error < bestError - 1e-5f || (error < bestError + 1e-5f && rank < bestRank)) {
+					bestError = error;
+					bestRank = rank;
+					coord = v;
+					*voltage = vVoltage;
+				}
+			}
+		}
+		return coord;
+	}
+
+	// Replace each harmonic k of the fundamental by the closest lattice point of the tuning
+	void updateLatticeSpectrum() {
+		latticeSpectrumDirty = false;
+		numLatticePartials = 0;
+		int maxHarmonic = getMaxLatticeHarmonic();
+
+		for (int k = 1; k <= maxHarmonic; k++) {
+			float target = log2f(k);
+			ScaleVector coord = {0, 0};
+			float voltage = target;
+			if (tuningPreset != TuningPresets::TUNING_HARMONIC) {
+				coord = closestLatticePoint(target, &voltage);
+			}
+			// Several harmonics may land on the same lattice point
+			if (numLatticePartials > 0 && latticeLog2RelFreqs[numLatticePartials - 1] >= voltage - 1e-6f) {
+				continue;
+			}
+			latticeCoords[numLatticePartials] = coord;
+			latticeLog2RelFreqs[numLatticePartials] = voltage;
+			latticeRelFreqs[numLatticePartials] = exp2f(voltage);
+			numLatticePartials++;
+		}
+	}
+
+	// Fill the current partial set from the drawbars, or from the lattice spectrum shaped by the drawbars
+	void updatePartials() {
+		float drawbarRelFreqs[NUM_DRAWBARS];
+		drawbarRelFreqs[0] = params[RELFREQ1_PARAM].getValue();
+		drawbarRelFreqs[1] = params[RELFREQ2_PARAM].getValue();
+		drawbarRelFreqs[2] = 1.f;
+		drawbarRelFreqs[3] = params[RELFREQ4_PARAM].getValue();
+		drawbarRelFreqs[4] = params[RELFREQ5_PARAM].getValue();
+		drawbarRelFreqs[5] = params[RELFREQ6_PARAM].getValue();
+		drawbarRelFreqs[6] = params[RELFREQ7_PARAM].getValue();
+		drawbarRelFreqs[7] = params[RELFREQ8_PARAM].getValue();
+		drawbarRelFreqs[8] = params[RELFREQ9_PARAM].getValue();
+		float drawbarAmps[NUM_DRAWBARS];
+		for (int i = 0; i < NUM_DRAWBARS; i++) {
+			drawbarAmps[i] = params[AMP1_PARAM + i].getValue();
+		}
+
+		if (partialSet == PartialSets::PARTIALS_DRAWBARS) {
+			numPartials = NUM_DRAWBARS;
+			fundamentalPartial = 2;
+			partialsOnLattice = drawbarsOnLattice;
+			for (int i = 0; i < NUM_DRAWBARS; i++) {
+				partialRelFreqs[i] = drawbarRelFreqs[i];
+				partialLog2RelFreqs[i] = log2f(std::max(drawbarRelFreqs[i], 1e-3f));
+				partialAmps[i] = drawbarAmps[i];
+				partialCoords[i] = drawbarCoords[i];
+				partialDrawbars[i][0] = partialDrawbars[i][1] = i;
+				partialDrawbarWeights[i][0] = 1.f;
+				partialDrawbarWeights[i][1] = 0.f;
+			}
+			outputGain = 1.f / NUM_DRAWBARS;
+			updatePercussionPartial();
+			return;
+		}
+
+		if (latticeSpectrumDirty) {
+			updateLatticeSpectrum();
+		}
+
+		// Drawbars act as a spectral envelope over log frequency, falling off as 1/f above the top drawbar
+		float nodeX[NUM_DRAWBARS];
+		int nodeDrawbar[NUM_DRAWBARS];
+		for (int i = 0; i < NUM_DRAWBARS; i++) {
+			float x = log2f(std::max(drawbarRelFreqs[i], 1e-3f));
+			int j = i;
+			for (; j > 0 && nodeX[j - 1] > x; j--) {
+				nodeX[j] = nodeX[j - 1];
+				nodeDrawbar[j] = nodeDrawbar[j - 1];
+			}
+			nodeX[j] = x;
+			nodeDrawbar[j] = i;
+		}
+
+		numPartials = numLatticePartials;
+		fundamentalPartial = 0;
+		partialsOnLattice = tuningPreset != TuningPresets::TUNING_HARMONIC;
+		int node = 0;
+		float weightSum = 0.f;
+		for (int p = 0; p < numLatticePartials; p++) {
+			float x = latticeLog2RelFreqs[p];
+			while (node < NUM_DRAWBARS - 1 && nodeX[node + 1] <= x) {
+				node++;
+			}
+			int* drawbars = partialDrawbars[p];
+			float* weights = partialDrawbarWeights[p];
+			if (x <= nodeX[0]) {
+				drawbars[0] = drawbars[1] = nodeDrawbar[0];
+				weights[0] = 1.f;
+				weights[1] = 0.f;
+			}
+			else if (node == NUM_DRAWBARS - 1) {
+				drawbars[0] = drawbars[1] = nodeDrawbar[node];
+				weights[0] = exp2f(nodeX[node] - x);
+				weights[1] = 0.f;
+			}
+			else {
+				float t = (x - nodeX[node]) / (nodeX[node + 1] - nodeX[node]);
+				drawbars[0] = nodeDrawbar[node];
+				drawbars[1] = nodeDrawbar[node + 1];
+				weights[0] = 1.f - t;
+				weights[1] = t;
+			}
+			partialRelFreqs[p] = latticeRelFreqs[p];
+			partialLog2RelFreqs[p] = x;
+			partialAmps[p] = weights[0] * drawbarAmps[drawbars[0]] + weights[1] * drawbarAmps[drawbars[1]];
+			partialCoords[p] = latticeCoords[p];
+			weightSum += weights[0] + weights[1];
+		}
+		outputGain = weightSum > 0.f ? 1.f / weightSum : 1.f;
+		updatePercussionPartial();
+	}
+
+	void updatePercussionPartial() {
+		percussionPartial = -1;
+		if (percussion == Percussion::PERCUSSION_OFF)
+			return;
+		float target = log2f(percussion == Percussion::PERCUSSION_SECOND ? 2.f : 3.f);
+		// Within a quarter tone, so that detuned drawbars still count
+		float bestDistance = 1.f / 24.f;
+		for (int p = 0; p < numPartials; p++) {
+			float distance = fabsf(partialLog2RelFreqs[p] - target);
+			if (distance < bestDistance) {
+				bestDistance = distance;
+				percussionPartial = p;
+			}
+		}
+	}
+
+	bool isEnvelopeActive() {
+		return (percussion != Percussion::PERCUSSION_OFF || keyClick) && inputs[GATE_INPUT].isConnected();
+	}
+
+	float_4 getFundamentalFreq(int c, float fmParam) {
+		float freqParam = params[FREQ_PARAM].getValue() / 12.f;
+		float_4 pitch = freqParam + inputs[PITCH_INPUT].getPolyVoltageSimd<float_4>(c);
+		float_4 freq;
+		if (!linear) {
+			pitch += inputs[FM_INPUT].getPolyVoltageSimd<float_4>(c) * fmParam;
+			freq = dsp::FREQ_C4 * dsp::exp2_taylor5(pitch);
+		}
+		else {
+			freq = dsp::FREQ_C4 * dsp::exp2_taylor5(pitch);
+			freq += dsp::FREQ_C4 * inputs[FM_INPUT].getPolyVoltageSimd<float_4>(c) * fmParam;
+		}
+		return freq;
+	}
+
+	int getQuality() {
+		return static_cast<int>(quality);
+	}
+	void setQuality(int q) {
+		quality = (Quality)q;
+		activeQuality = quality;
+		governor.reset();
+	}
+
+	// CPU budget in percent of the sample period
+	float getCpuBudgetPercent() {
+		static const float budgets[] = {0.f, 0.5f, 1.f, 2.f, 5.f, 10.f};
+		return budgets[clamp(cpuBudget, 0, 5)];
+	}
+	void setCpuBudget(int b) {
+		cpuBudget = b;
+		governor.budget = getCpuBudgetPercent() / 100.f;
+		// Start again from the selected tier
+		setQuality((int)quality);
+	}
+
+	float getGateHoldTime() {
+		static const float holdTimes[] = {0.f, 0.5f, 2.f, 10.f};
+		return holdTimes[clamp(gateHold, 0, 3)];
+	}
+
+	// Without a gate cable all voices are active
+	void updateVoiceActivity(const ProcessArgs& args) {
+		bool gated = inputs[GATE_INPUT].isConnected();
+		float holdTime = getGateHoldTime();
+		float blockTime = CONTROL_BLOCK_SIZE * args.sampleTime;
+		for (int v = 0; v < 16; v++) {
+			bool active = v < channels;
+			bool gate = active && gated && inputs[GATE_INPUT].getPolyVoltage(v) >= 1.f;
+			// Envelopes restart when the gate opens
+			voiceEnvTime[v] = gate && !voiceGateHigh[v] ? 0.f : voiceEnvTime[v] + blockTime;
+			voiceGateHigh[v] = gate;
+			if (active && gated) {
+				if (gate)
+					voiceHoldTime[v] = holdTime;
+				else
+					voiceHoldTime[v] -= blockTime;
+				active = voiceHoldTime[v] >= 0.f;
+			}
+			voiceReactivated[v] = active && !voiceActive[v];
+			voiceActive[v] = active;
+		}
+	}
+
+	int getOversampleIndex() {
+		return oversample == 4 ? 2 : oversample == 2 ? 1 : 0;
+	}
+	void setOversampleIndex(int i) {
+		oversample = 1 << clamp(i, 0, 2);
+	}
+
+	const VCOMHExpanderMessage* getExpanderMessage() {
+		if (rightExpander.module && rightExpander.module->model == modelMicroHammondCV)
+			return (const VCOMHExpanderMessage*) rightExpander.consumerMessage;
+		return NULL;
+	}
+
+	// Drawbar levels of four voices, the knob plus 10 V for a full drawbar
+	void getCvDrawbars(const VCOMHExpanderMessage* message, int c, float_4* drawbars) {
+		for (int i = 0; i < NUM_DRAWBARS; i++) {
+			float knob = params[AMP1_PARAM + i].getValue();
+			if (message->connected[i])
+				drawbars[i] = simd::clamp(knob + float_4::load(&message->voltages[i][c]) / 10.f, 0.f, 1.f);
+			else
+				drawbars[i] = knob;
+		}
+	}
+
+	float_4 getPartialCvAmp(int p, const float_4* drawbars) {
+		return partialDrawbarWeights[p][0] * drawbars[partialDrawbars[p][0]] + partialDrawbarWeights[p][1] * drawbars[partialDrawbars[p][1]];
+	}
+
+	SineShape getSineShape() {
+		return qualitySineShapes[(int)activeQuality];
+	}
+
+	bool isAudioRateFm() {
+		if (activeQuality == Quality::QUALITY_ECO)
+			return false;
+		if (!inputs[FM_INPUT].isConnected() || params[FM_PARAM].getValue() == 0.f)
+			return false;
+		return audioRateFm || activeQuality == Quality::QUALITY_HIGH;
+	}
+
+	// Assign the partials of all voices to shared wheels. Returns false if the bank ran out of wheels.
+	bool updateTonewheels(const ProcessArgs& args, bool jump) {
 		float freqParam = params[FREQ_PARAM].getValue() / 12.f;
+		tonewheelBank.shape = getSineShape();
+		tonewheelBank.beginUpdate();
+
+		numTonewheelPartials = 0;
+		for (int p = 0; p < numPartials; p++) {
+			if (partialAmps[p] <= PARTIAL_AMP_THRESHOLD && tonewheelAmps[p] <= PARTIAL_AMP_THRESHOLD) {
+				tonewheelAmps[p] = 0.f;
+				tonewheelAmpSteps[p] = 0.f;
+				continue;
+			}
+			tonewheelPartials[numTonewheelPartials++] = p;
+			tonewheelAmpSteps[p] = (partialAmps[p] - tonewheelAmps[p]) / CONTROL_BLOCK_SIZE;
+		}
+
+		auto freqForCoord = [&](ScaleVector c) {
+			return dsp::FREQ_C4 * exp2f(freqParam + tuning.vecToVoltageNoOffset(c));
+		};
+
+		for (int v = 0; v < channels; v++) {
+			// Quantize the voice pitch to the lattice, only when it changes
+			float pitch = inputs[PITCH_INPUT].getPolyVoltage(v);
+			ScaleVector coord = voiceCoords[v];
+			if (pitch != voicePitches[v] || voiceCoordsDirty || jump) {
+				float voltage;
+				coord = closestLatticePoint(pitch, &voltage);
+				voicePitches[v] = pitch;
+			}
+			// Inactive voices read the silent wheel, and fade in and out like a note change
+			bool active = voiceActive[v];
+			bool wasActive = tonewheelVoiceActive[v] && !jump;
+			voiceFading[v] = !jump && (active != wasActive || (active && coord != voiceCoords[v]));
+			prevVoiceCoords[v] = voiceCoords[v];
+			voiceCoords[v] = coord;
+			voiceFade[v / 4][v % 4] = voiceFading[v] ? 0.f : 1.f;
+			tonewheelVoiceActive[v] = active;
+
+			for (int i = 0; i < numTonewheelPartials; i++) {
+				int p = tonewheelPartials[i];
+				wheelIndices[p][v] = active ? tonewheelBank.getWheel(coord + partialCoords[p], args.sampleTime, freqForCoord) : LatticeTonewheelBank::SILENT_WHEEL;
+				if (voiceFading[v]) {
+					prevWheelIndices[p][v] = wasActive ? tonewheelBank.getWheel(prevVoiceCoords[v] + partialCoords[p], args.sampleTime, freqForCoord) : LatticeTonewheelBank::SILENT_WHEEL;
+				}
+			}
+		}
+		voiceCoordsDirty = false;
+		return !tonewheelBank.overflow;
+	}
+
+	// Lanes of the voices c..c+3 that are active, and that just became active
+	int getActiveMask(int c, int* reactivatedMask) {
+		int activeMask = 0;
+		*reactivatedMask = 0;
+		for (int j = 0; j < std::min(channels - c, 4); j++) {
+			activeMask |= voiceActive[c + j] << j;
+			*reactivatedMask |= voiceReactivated[c + j] << j;
+		}
+		return activeMask;
+	}
+
+	// Keeps the wavetable in sync with the partial set. Returns false if there is no table for it.
+	bool updateWavetable() {
+		bool changed = numPartials != wavetableNumPartials
+			|| std::memcmp(partialRelFreqs, wavetableRelFreqs, numPartials * sizeof(float))
+			|| std::memcmp(partialAmps, wavetableAmps, numPartials * sizeof(float));
+		if (changed) {
+			wavetableNumPartials = numPartials;
+			std::copy(partialRelFreqs, partialRelFreqs + numPartials, wavetableRelFreqs);
+			std::copy(partialAmps, partialAmps + numPartials, wavetableAmps);
+			wavetableHarmonic = wavetableSpec.fromPartials(partialRelFreqs, partialAmps, numPartials, PARTIAL_AMP_THRESHOLD);
+			wavetableSpecDirty = wavetableHarmonic;
+		}
+		// The back table is read until the crossfade is over
+		if (wavetableFade < 1.f)
+			return wavetableHarmonic && wavetableBuilder.hasTable;
+		if (wavetableSpecDirty && wavetableBuilder.request(wavetableSpec)) {
+			wavetableSpecDirty = false;
+		}
+		if (wavetableBuilder.poll()) {
+			// Keep the fundamental in phase across tables of different periods
+			int oldCycles = wavetableBuilder.getBack().cycles;
+			int newCycles = wavetableBuilder.getFront().cycles;
+			for (int g = 0; g < 4; g++) {
+				prevWavetablePhase[g] = wavetablePhase[g];
+				float_4 fundamentalPhase = wavetablePhase[g] * oldCycles;
+				wavetablePhase[g] = (fundamentalPhase - simd::floor(fundamentalPhase)) / newCycles;
+			}
+			wavetableFade = wavetableActive ? 0.f : 1.f;
+		}
+		return wavetableHarmonic && wavetableBuilder.hasTable;
+	}
+
+	void updateWavetableVoices(const ProcessArgs& args, bool jump) {
 		float fmParam = params[FM_PARAM].getValue();
-		bool linear = params[LINEAR_PARAM].getValue() > 0.f;
-		bool soft = params[SYNC_PARAM].getValue() <= 0.f;
-
-		// Get relative frequencies
-		float relFreqs[9];
-		relFreqs[0] = params[RELFREQ1_PARAM].getValue();
-		relFreqs[1] = params[RELFREQ2_PARAM].getValue();
-		relFreqs[2] = 1.f;
-		relFreqs[3] = params[RELFREQ4_PARAM].getValue();
-		relFreqs[4] = params[RELFREQ5_PARAM].getValue();
-		relFreqs[5] = params[RELFREQ6_PARAM].getValue();
-		relFreqs[6] = params[RELFREQ7_PARAM].getValue();
-		relFreqs[7] = params[RELFREQ8_PARAM].getValue();
-		relFreqs[8] = params[RELFREQ9_PARAM].getValue();
-
-		// Get amplitudes
-		float amps[9];
-		amps[0] = params[AMP1_PARAM].getValue();
-		amps[1] = params[AMP2_PARAM].getValue();
-		amps[2] = params[AMP3_PARAM].getValue();
-		amps[3] = params[AMP4_PARAM].getValue();
-		amps[4] = params[AMP5_PARAM].getValue();
-		amps[5] = params[AMP6_PARAM].getValue();
-		amps[6] = params[AMP7_PARAM].getValue();
-		amps[7] = params[AMP8_PARAM].getValue();
-		amps[8] = params[AMP9_PARAM].getValue();
-
-		int channels = std::max(inputs[PITCH_INPUT].getChannels(), 1);
+		bool audioRate = isAudioRateFm();
+		float nyquist = args.sampleRate / 2.f;
+		const Wavetable& table = wavetableBuilder.getFront();
+		const Wavetable& prevTable = wavetableBuilder.getBack();
 
 		for (int c = 0; c < channels; c += 4) {
-			float_4 signal = 0.f;
-			for (int osc=0; osc<NUM_OSCILLATORS; osc++){
-
-				auto& oscillator = oscillators[(c / 4)*9+osc];
-				oscillator.channels = std::min(channels - c, 4);
-				// removed
-				oscillator.analog = true;
-				oscillator.soft = soft;
-
-				// Get frequency
-				float_4 pitch = freqParam + inputs[PITCH_INPUT].getPolyVoltageSimd<float_4>(c);
-				float_4 freq;
-				if (!linear) {
-					pitch += inputs[FM_INPUT].getPolyVoltageSimd<float_4>(c) * fmParam;
-					freq = dsp::FREQ_C4 * dsp::exp2_taylor5(pitch);
+			int g = c / 4;
+			int reactivatedMask;
+			float_4 laneMask = simd::movemaskInverse<float_4>(getActiveMask(c, &reactivatedMask));
+			float_4 reactivated = simd::movemaskInverse<float_4>(reactivatedMask);
+			if (jump) {
+				reactivated = float_4::mask();
+			}
+
+			float_4 freq = clamp(getFundamentalFreq(c, fmParam), 0.f, nyquist);
+			wavetablePhase[g] = simd::ifelse(reactivated, 0.f, wavetablePhase[g]);
+			wavetableFreq[g] = simd::ifelse(reactivated, freq, wavetableFreq[g]);
+			wavetableFreqStep[g] = audioRate ? 0.f : (freq - wavetableFreq[g]) / CONTROL_BLOCK_SIZE;
+			wavetableGainStep[g] = ((laneMask & float_4(1.f)) - wavetableGain[g]) / CONTROL_BLOCK_SIZE;
+
+			// Mip level from the higher of the two pitches in the block
+			float_4 maxFreq = simd::fmax(freq, wavetableFreq[g]);
+			for (int j = 0; j < 4; j++) {
+				wavetableLevels[c + j] = Wavetable::getLevel(maxFreq[j] / table.cycles, args.sampleTime);
+				prevWavetableLevels[c + j] = Wavetable::getLevel(maxFreq[j] / prevTable.cycles, args.sampleTime);
+			}
+		}
+	}
+
+	void processWavetable(const ProcessArgs& args) {
+		bool audioRate = isAudioRateFm();
+		float fmParam = params[FM_PARAM].getValue();
+		const Wavetable& table = wavetableBuilder.getFront();
+		const Wavetable& prevTable = wavetableBuilder.getBack();
+		bool fading = wavetableFade < 1.f;
+
+		for (int c = 0; c < channels; c += 4) {
+			int g = c / 4;
+			if (audioRate) {
+				wavetableFreq[g] = clamp(getFundamentalFreq(c, fmParam), 0.f, args.sampleRate / 2.f);
+			}
+			float_4& phase = wavetablePhase[g];
+			phase += wavetableFreq[g] * (args.sampleTime / table.cycles);
+			phase -= simd::floor(phase);
+			float_4 v;
+			for (int j = 0; j < 4; j++) {
+				v[j] = table.lookup(wavetableLevels[c + j], phase[j]);
+			}
+			if (fading) {
+				float_4& prevPhase = prevWavetablePhase[g];
+				prevPhase += wavetableFreq[g] * (args.sampleTime / prevTable.cycles);
+				prevPhase -= simd::floor(prevPhase);
+				float_4 prev;
+				for (int j = 0; j < 4; j++) {
+					prev[j] = prevTable.lookup(prevWavetableLevels[c + j], prevPhase[j]);
 				}
-				else {
-					freq = dsp::FREQ_C4 * dsp::exp2_taylor5(pitch);
-					freq += dsp::FREQ_C4 * inputs[FM_INPUT].getPolyVoltageSimd<float_4>(c) * fmParam;
+				v = prev + wavetableFade * (v - prev);
+			}
+			float_4 signal = wavetableGain[g] * v;
+			if (outputs[SIN_OUTPUT].isConnected())
+				outputs[SIN_OUTPUT].setVoltageSimd(outputGain * signal, c);
+
+			wavetableFreq[g] += wavetableFreqStep[g];
+			wavetableGain[g] += wavetableGainStep[g];
+		}
+		if (fading) {
+			wavetableFade = std::min(wavetableFade + 1.f / WAVETABLE_FADE_SAMPLES, 1.f);
+		}
+	}
+
+	// Called once per control block: snapshot params and set up linear ramps towards the new targets.
+	// Partials above Nyquist or below the amplitude threshold are culled per voice.
+	void processControl(const ProcessArgs& args) {
+		float fmParam = params[FM_PARAM].getValue();
+		linear = params[LINEAR_PARAM].getValue() > 0.f;
+		soft = params[SYNC_PARAM].getValue() <= 0.f;
+
+		updatePartials();
+
+		int newChannels = std::max(inputs[PITCH_INPUT].getChannels(), 1);
+		// Voices that were silent jump straight to their pitch instead of gliding in
+		bool jump = newChannels != channels;
+		channels = newChannels;
+		updateVoiceActivity(args);
+
+		const VCOMHExpanderMessage* cvMessage = getExpanderMessage();
+		cvConnected = false;
+		for (int i = 0; cvMessage && i < NUM_EXPANDER_CVS; i++) {
+			cvConnected = cvConnected || cvMessage->connected[i];
+		}
+
+		bool envelopes = isEnvelopeActive();
+
+		// A wavetable cannot be synced per partial nor shaped per voice
+		bool useWavetable = wavetable && !inputs[SYNC_INPUT].isConnected() && !cvConnected && !envelopes && updateWavetable();
+		if (useWavetable) {
+			updateWavetableVoices(args, jump || !wavetableActive);
+		}
+		jump = jump || wavetableActive != useWavetable;
+		wavetableActive = useWavetable;
+		if (wavetableActive) {
+			tonewheelsActive = false;
+			return;
+		}
+
+		// Tonewheels are shared by all voices, so per-voice FM, sync and timbre are not available
+		bool useTonewheels = tonewheels && partialsOnLattice && !inputs[FM_INPUT].isConnected() && !inputs[SYNC_INPUT].isConnected() && !cvConnected && !envelopes;
+		if (useTonewheels) {
+			useTonewheels = updateTonewheels(args, jump || !tonewheelsActive);
+		}
+		// Per-voice partials resume at their current pitch when leaving tonewheel mode
+		jump = jump || tonewheelsActive != useTonewheels;
+		tonewheelsActive = useTonewheels;
+		if (tonewheelsActive) {
+			return;
+		}
+
+		bool audioRate = isAudioRateFm();
+		bool syncEnabled = inputs[SYNC_INPUT].isConnected();
+		float nyquist = args.sampleRate / 2.f;
+
+		int newOversample = activeQuality == Quality::QUALITY_ECO ? 1 : oversample;
+		if (activeQuality == Quality::QUALITY_HIGH && syncEnabled) {
+			newOversample = std::max(newOversample, HIGH_SYNC_OVERSAMPLE);
+		}
+		if (newOversample != activeOversample) {
+			for (auto& decimator : decimators) {
+				decimator.reset();
+			}
+			activeOversample = newOversample;
+		}
+		// Ramps advance once per oversampled step
+		float rampSteps = CONTROL_BLOCK_SIZE * activeOversample;
+
+		for (int c = 0; c < channels; c += 4) {
+			auto& bank = banks[c / 4];
+			bank.channels = std::min(channels - c, 4);
+			bank.shape = getSineShape();
+			bank.soft = soft;
+			bank.syncEnabled = syncEnabled;
+			bank.minBlep = activeQuality != Quality::QUALITY_ECO;
+
+			// Inactive voices fade out over the block and are culled like silent partials
+			int reactivatedMask;
+			float_4 laneMask = simd::movemaskInverse<float_4>(getActiveMask(c, &reactivatedMask));
+			float_4 reactivated = simd::movemaskInverse<float_4>(reactivatedMask);
+			if (reactivatedMask) {
+				// Restart all partials of the voice in phase, like a fresh note
+				for (int p = 0; p < MAX_PARTIALS; p++) {
+					bank.phase[p] = simd::ifelse(reactivated, 0.f, bank.phase[p]);
+				}
+			}
+			float_4 freq = getFundamentalFreq(c, fmParam);
+
+			// Per-voice drawbars and tilt from the CV expander
+			int g = c / 4;
+			float_4 drawbars[NUM_DRAWBARS];
+			float_4 tilt = 0.f;
+			bool audioRateCv = false;
+			if (cvConnected) {
+				getCvDrawbars(cvMessage, c, drawbars);
+				for (int i = 0; i < NUM_DRAWBARS; i++) {
+					audioRateCv = audioRateCv || simd::movemask(simd::abs(drawbars[i] - cvDrawbars[g][i]) > CV_AUDIO_RATE_THRESHOLD);
+					cvDrawbars[g][i] = drawbars[i];
+				}
+				if (cvMessage->connected[TILT_CV])
+					tilt = float_4::load(&cvMessage->voltages[TILT_CV][c]);
+			}
+			cvAudioRate[g] = audioRateCv;
+
+			// Percussion at the end of the block, the amplitude ramps interpolate it per sample.
+			// The key click starts from its value at the start of the block and decays per sample in the bank.
+			float_4 percussionEnv = 0.f;
+			float_4 clickEnv = 0.f;
+			if (envelopes) {
+				float_4 envTime = float_4::load(&voiceEnvTime[c]);
+				float decay = percussionSlow ? PERCUSSION_SLOW_DECAY : PERCUSSION_FAST_DECAY;
+				if (percussionPartial >= 0)
+					percussionEnv = PERCUSSION_LEVEL * dsp::exp2_taylor5(simd::fmax((envTime + CONTROL_BLOCK_SIZE * args.sampleTime) * (-float(M_LOG2E) / decay), -30.f));
+				if (keyClick)
+					clickEnv = KEY_CLICK_LEVEL * dsp::exp2_taylor5(simd::fmax(envTime * (-float(M_LOG2E) / KEY_CLICK_DECAY), -30.f));
+			}
+			clickEnv = clickEnv & laneMask;
+			bank.clickActive = simd::movemask(clickEnv > PARTIAL_AMP_THRESHOLD);
+			bank.click = clickEnv;
+			bank.clickDecay = dsp::exp2_taylor5(-float(M_LOG2E) * args.sampleTime / (activeOversample * KEY_CLICK_DECAY));
+
+			bank.numActive = 0;
+			for (int p = 0; p < numPartials; p++) {
+				float_4 target = freq * partialRelFreqs[p];
+				float_4 gain = laneMask & (target < nyquist) & float_4(1.f);
+				float_4 amp = partialAmps[p];
+				if (cvConnected) {
+					// 3 dB per octave and volt
+					if (cvMessage->connected[TILT_CV])
+						gain *= dsp::exp2_taylor5(tilt * (0.5f * partialLog2RelFreqs[p]));
+					amp = getPartialCvAmp(p, drawbars);
+				}
+				float_4 env = p == percussionPartial ? percussionEnv : 0.f;
+				float_4 ampTarget = gain * (amp + env);
+				bank.clickGain[p] = gain;
+				cvGainStep[g][p] = audioRateCv ? (gain - cvGain[g][p]) / CONTROL_BLOCK_SIZE : 0.f;
+				envAmpStep[g][p] = audioRateCv ? (env - envAmp[g][p]) / CONTROL_BLOCK_SIZE : 0.f;
+				if (!audioRateCv) {
+					cvGain[g][p] = gain;
+					envAmp[g][p] = env;
 				}
 
-				freq *= relFreqs[osc];
-				freq = clamp(freq, 0.f, args.sampleRate / 2.f);
-				oscillator.freq = freq;
+				bool wasActive = simd::movemask(bank.amp[p] != 0.f);
+				bool audible = simd::movemask(ampTarget > PARTIAL_AMP_THRESHOLD) || simd::movemask(bank.amp[p] > PARTIAL_AMP_THRESHOLD);
+				audible = audible || (bank.clickActive && simd::movemask(gain > 0.f));
+				// Fast CVs may open a partial within the block
+				audible = audible || (audioRateCv && simd::movemask(gain > 0.f) && partialDrawbarWeights[p][0] + partialDrawbarWeights[p][1] > 0.f);
+				if (!audible) {
+					bank.amp[p] = 0.f;
+					bank.ampStep[p] = 0.f;
+					cvGain[g][p] = gain;
+					cvGainStep[g][p] = 0.f;
+					envAmp[g][p] = env;
+					envAmpStep[g][p] = 0.f;
+					continue;
+				}
+				bank.activePartials[bank.numActive++] = p;
+
+				target = clamp(target, 0.f, nyquist);
+				if (jump || !wasActive) {
+					bank.freq[p] = target;
+				}
+				bank.freq[p] = simd::ifelse(reactivated, target, bank.freq[p]);
+				bank.freqStep[p] = audioRate ? 0.f : (target - bank.freq[p]) / rampSteps;
+				bank.ampStep[p] = audioRateCv ? 0.f : (ampTarget - bank.amp[p]) / rampSteps;
+			}
+		}
+	}
 
-				oscillator.syncEnabled = inputs[SYNC_INPUT].isConnected();
-				float_4 sync = inputs[SYNC_INPUT].getPolyVoltageSimd<float_4>(c);
-				oscillator.process(args.sampleTime, sync);
+	void processTonewheels(const ProcessArgs& args) {
+		tonewheelBank.process();
+		const float* wheels = tonewheelBank.out;
 
-				signal += amps[osc] * oscillator.sin();
-	
+		for (int c = 0; c < channels; c += 4) {
+			int g = c / 4;
+			bool fading = simd::movemask(voiceFade[g] < 1.f);
+			float_4 signal = 0.f;
+			float_4 prevSignal = 0.f;
+			for (int i = 0; i < numTonewheelPartials; i++) {
+				int p = tonewheelPartials[i];
+				const int* w = &wheelIndices[p][c];
+				signal += tonewheelAmps[p] * float_4(wheels[w[0]], wheels[w[1]], wheels[w[2]], wheels[w[3]]);
+				if (fading) {
+					// Lanes that are not fading read the silent wheel
+					int pw[4];
+					for (int j = 0; j < 4; j++)
+						pw[j] = voiceFading[c + j] ? prevWheelIndices[p][c + j] : LatticeTonewheelBank::SILENT_WHEEL;
+					prevSignal += tonewheelAmps[p] * float_4(wheels[pw[0]], wheels[pw[1]], wheels[pw[2]], wheels[pw[3]]);
+				}
+			}
+			if (fading) {
+				signal = prevSignal + voiceFade[g] * (signal - prevSignal);
+				voiceFade[g] = simd::fmin(voiceFade[g] + 1.f / CONTROL_BLOCK_SIZE, 1.f);
 			}
-			// Set output
 			if (outputs[SIN_OUTPUT].isConnected())
-				outputs[SIN_OUTPUT].setVoltageSimd(.11111f * signal, c);
+				outputs[SIN_OUTPUT].setVoltageSimd(outputGain * signal, c);
+		}
+		for (int i = 0; i < numTonewheelPartials; i++) {
+			int p = tonewheelPartials[i];
+			tonewheelAmps[p] += tonewheelAmpSteps[p];
+		}
+	}
+
+	void process(const ProcessArgs& args) override {
+		if (blockPos == 0) {
+			governor.beginBlock();
+		}
+		double startTime = governor.measuring ? system::getTime() : 0.;
+
+		if (blockPos == 0) {
+			processControl(args);
+		}
+
+		bool audioRate = isAudioRateFm();
+		float fmParam = params[FM_PARAM].getValue();
+		bool outputConnected = outputs[SIN_OUTPUT].isConnected();
+		const VCOMHExpanderMessage* cvMessage = cvConnected ? getExpanderMessage() : NULL;
+
+		if (wavetableActive) {
+			processWavetable(args);
+		}
+		else if (tonewheelsActive) {
+			processTonewheels(args);
+		}
+		for (int c = 0; c < channels && !tonewheelsActive && !wavetableActive; c += 4) {
+			auto& bank = banks[c / 4];
+			float_4 sync = inputs[SYNC_INPUT].getPolyVoltageSimd<float_4>(c);
+			if (audioRate) {
+				float_4 freq = getFundamentalFreq(c, fmParam);
+				for (int i = 0; i < bank.numActive; i++) {
+					int p = bank.activePartials[i];
+					bank.freq[p] = clamp(freq * partialRelFreqs[p], 0.f, args.sampleRate / 2.f);
+				}
+			}
+			if (cvMessage && cvAudioRate[c / 4]) {
+				float_4 drawbars[NUM_DRAWBARS];
+				getCvDrawbars(cvMessage, c, drawbars);
+				float_4* gain = cvGain[c / 4];
+				const float_4* gainStep = cvGainStep[c / 4];
+				float_4* env = envAmp[c / 4];
+				const float_4* envStep = envAmpStep[c / 4];
+				for (int i = 0; i < bank.numActive; i++) {
+					int p = bank.activePartials[i];
+					bank.amp[p] = gain[p] * (getPartialCvAmp(p, drawbars) + env[p]);
+					gain[p] += gainStep[p];
+					env[p] += envStep[p];
+				}
+			}
+			float_4 signal;
+			if (activeOversample > 1) {
+				// Interpolate sync so crossings are found in the right substep
+				float_4 lastSync = bank.lastSyncValue;
+				float_4 buffer[4];
+				for (int k = 0; k < activeOversample; k++) {
+					float_4 subSync = lastSync + (sync - lastSync) * ((k + 1.f) / activeOversample);
+					buffer[k] = bank.process(args.sampleTime / activeOversample, subSync);
+				}
+				signal = decimators[c / 4].process(activeOversample, buffer);
+			}
+			else {
+				signal = bank.process(args.sampleTime, sync);
+			}
+			// Set output
+			if (outputConnected)
+				outputs[SIN_OUTPUT].setVoltageSimd(outputGain * signal, c);
+		}
+		if (++blockPos >= CONTROL_BLOCK_SIZE) {
+			blockPos = 0;
+		}
 
+		if (governor.measuring) {
+			int step = governor.addSample(system::getTime() - startTime, args.sampleTime);
+			int q = clamp((int)activeQuality + step, (int)Quality::QUALITY_ECO, (int)quality);
+			if (q != (int)activeQuality) {
+				activeQuality = (Quality)q;
+				// Let the new tier settle before judging it
+				governor.reset();
+			}
 		}
 
 		outputs[SIN_OUTPUT].setChannels(channels);
@@ -401,7 +1528,8 @@ struct VCOMH : Module {
 		// Light
 		if (lightDivider.process()) {
 			if (channels == 1) {
-				float lightValue = oscillators[0].light()[0];
+				float lightValue = wavetableActive ? std::sin(2 * M_PI * wavetablePhase[0][0] * wavetableBuilder.getFront().cycles) :
+					tonewheelsActive ? tonewheelBank.light(wheelIndices[fundamentalPartial][0]) : banks[0].light(fundamentalPartial)[0];
 				lights[PHASE_LIGHT + 0].setSmoothBrightness(-lightValue, args.sampleTime * lightDivider.getDivision());
 				lights[PHASE_LIGHT + 1].setSmoothBrightness(lightValue, args.sampleTime * lightDivider.getDivision());
 				lights[PHASE_LIGHT + 2].setBrightness(0.f);
@@ -437,6 +1565,13 @@ struct VCOMH : Module {
 				params[RELFREQ8_PARAM].setValue(tuning.vecToFreqRatio(tuning.V1()+scale.scale_system*2));
 				params[RELFREQ9_PARAM].setValue(tuning.vecToFreqRatio({3*scale.scale_system.x, 3*scale.scale_system.y}));
 
+				ScaleVector sys = scale.scale_system;
+				ScaleVector coords[NUM_DRAWBARS] = {-sys, tuning.V1(), {0, 0}, sys, tuning.V1() + sys, sys * 2, tuning.V2() + sys * 2, tuning.V1() + sys * 2, sys * 3};
+				std::copy(coords, coords + NUM_DRAWBARS, drawbarCoords);
+				drawbarsOnLattice = true;
+				latticeSpectrumDirty = true;
+				voiceCoordsDirty = true;
+
 
 			}
 
@@ -449,13 +1584,60 @@ struct VCOMH : Module {
 	json_t* dataToJson() override {
 		json_t* rootJ = json_object();
 		json_object_set_new(rootJ, "tuningPreset", json_integer((int)tuningPreset));
+		json_object_set_new(rootJ, "audioRateFm", json_boolean(audioRateFm));
+		json_object_set_new(rootJ, "partialSet", json_integer((int)partialSet));
+		json_object_set_new(rootJ, "tonewheels", json_boolean(tonewheels));
+		json_object_set_new(rootJ, "wavetable", json_boolean(wavetable));
+		json_object_set_new(rootJ, "quality", json_integer((int)quality));
+		json_object_set_new(rootJ, "cpuBudget", json_integer(cpuBudget));
+		json_object_set_new(rootJ, "gateHold", json_integer(gateHold));
+		json_object_set_new(rootJ, "oversample", json_integer(oversample));
+		json_object_set_new(rootJ, "percussion", json_integer((int)percussion));
+		json_object_set_new(rootJ, "percussionSlow", json_boolean(percussionSlow));
+		json_object_set_new(rootJ, "keyClick", json_boolean(keyClick));
 		return rootJ;
 	}
 
 	void dataFromJson(json_t* rootJ) override {
 		json_t* tuningPresetJ = json_object_get(rootJ, "tuningPreset");
-		if (tuningPresetJ)
+		if (tuningPresetJ) {
 			tuningPreset = (TuningPresets)json_integer_value(tuningPresetJ);
+			// Restore the tuning the lattice spectrum is derived from, synced tunings arrive via TDAT
+			if (tuningPreset != TuningPresets::TUNING_SYNCED)
+				setTuningPreset((int)tuningPreset);
+		}
+		json_t* partialSetJ = json_object_get(rootJ, "partialSet");
+		if (partialSetJ)
+			setPartialSet(json_integer_value(partialSetJ));
+		json_t* tonewheelsJ = json_object_get(rootJ, "tonewheels");
+		if (tonewheelsJ)
+			tonewheels = json_boolean_value(tonewheelsJ);
+		json_t* wavetableJ = json_object_get(rootJ, "wavetable");
+		if (wavetableJ)
+			setWavetable(json_boolean_value(wavetableJ));
+		json_t* audioRateFmJ = json_object_get(rootJ, "audioRateFm");
+		if (audioRateFmJ)
+			audioRateFm = json_boolean_value(audioRateFmJ);
+		json_t* qualityJ = json_object_get(rootJ, "quality");
+		if (qualityJ)
+			quality = (Quality)json_integer_value(qualityJ);
+		json_t* cpuBudgetJ = json_object_get(rootJ, "cpuBudget");
+		setCpuBudget(cpuBudgetJ ? json_integer_value(cpuBudgetJ) : 0);
+		json_t* gateHoldJ = json_object_get(rootJ, "gateHold");
+		if (gateHoldJ)
+			gateHold = json_integer_value(gateHoldJ);
+		json_t* oversampleJ = json_object_get(rootJ, "oversample");
+		if (oversampleJ)
+			oversample = json_integer_value(oversampleJ);
+		json_t* percussionJ = json_object_get(rootJ, "percussion");
+		if (percussionJ)
+			percussion = (Percussion)json_integer_value(percussionJ);
+		json_t* percussionSlowJ = json_object_get(rootJ, "percussionSlow");
+		if (percussionSlowJ)
+			percussionSlow = json_boolean_value(percussionSlowJ);
+		json_t* keyClickJ = json_object_get(rootJ, "keyClick");
+		if (keyClickJ)
+			keyClick = json_boolean_value(keyClickJ);
 	}
 };
 
@@ -510,6 +1692,7 @@ struct VCOMHWidget : ModuleWidget {
 		addInput(createInputCentered<ThemedPJ301MPort>(mm2px(Vec(17.444, 113.115)), module, VCOMH::PITCH_INPUT));
 		addInput(createInputCentered<ThemedPJ301MPort>(mm2px(Vec(28.282, 113.115)), module, VCOMH::SYNC_INPUT));
 		addInput(createInputCentered<ThemedPJ301MPort>(mm2px(Vec(39.15, 96.859)), module, VCOMH::TUNING_DATA_INPUT));
+		addInput(createInputCentered<ThemedPJ301MPort>(mm2px(Vec(6.607, 29.808)), module, VCOMH::GATE_INPUT));
 
 		addOutput(createOutputCentered<ThemedPJ301MPort>(mm2px(Vec(39.15, 113.115)), module, VCOMH::SIN_OUTPUT));
 
@@ -547,8 +1730,187 @@ struct VCOMHWidget : ModuleWidget {
 				module->setTuningPreset(tuning);
 			}
 		));
+
+		menu->addChild(createIndexSubmenuItem("Partials",
+			{
+				"9 drawbars",
+				"16 lattice harmonics",
+				"32 lattice harmonics",
+				"64 lattice harmonics",
+			},
+			[=]() {
+				return module->getPartialSet();
+			},
+			[=](int partialSet) {
+				module->setPartialSet(partialSet);
+			}
+		));
+
+		menu->addChild(createBoolPtrMenuItem("Shared tonewheels", "", &module->tonewheels));
+		menu->addChild(createBoolMenuItem("Wavetable", "",
+			[=]() {
+				return module->wavetable;
+			},
+			[=](bool enabled) {
+				module->setWavetable(enabled);
+			}
+		));
+		menu->addChild(createBoolPtrMenuItem("Audio-rate FM", "", &module->audioRateFm));
+
+		menu->addChild(createIndexSubmenuItem("Gate hold",
+			{
+				"None",
+				"0.5 s",
+				"2 s",
+				"10 s",
+			},
+			[=]() {
+				return module->gateHold;
+			},
+			[=](int hold) {
+				module->gateHold = hold;
+			}
+		));
+
+		menu->addChild(createIndexSubmenuItem("Percussion",
+			{
+				"Off",
+				"Second harmonic",
+				"Third harmonic",
+			},
+			[=]() {
+				return (int)module->percussion;
+			},
+			[=](int percussion) {
+				module->percussion = (VCOMH::Percussion)percussion;
+			}
+		));
+		menu->addChild(createBoolPtrMenuItem("Slow percussion decay", "", &module->percussionSlow));
+		menu->addChild(createBoolPtrMenuItem("Key click", "", &module->keyClick));
+
+		menu->addChild(createIndexSubmenuItem("Oversampling",
+			{
+				"Off",
+				"2x",
+				"4x",
+			},
+			[=]() {
+				return module->getOversampleIndex();
+			},
+			[=](int i) {
+				module->setOversampleIndex(i);
+			}
+		));
+
+		menu->addChild(createIndexSubmenuItem("Quality",
+			{
+				"Eco",
+				"Standard",
+				"High",
+			},
+			[=]() {
+				return module->getQuality();
+			},
+			[=](int quality) {
+				module->setQuality(quality);
+			}
+		));
+
+		menu->addChild(createIndexSubmenuItem("CPU budget",
+			{
+				"Unlimited",
+				"0.5%",
+				"1%",
+				"2%",
+				"5%",
+				"10%",
+			},
+			[=]() {
+				return module->cpuBudget;
+			},
+			[=](int budget) {
+				module->setCpuBudget(budget);
+			}
+		));
+		if (module->activeQuality != module->quality) {
+			static const char* qualityNames[] = {"Eco", "Standard", "High"};
+			menu->addChild(createMenuLabel(string::f("Reduced to %s to stay within budget", qualityNames[(int)module->activeQuality])));
+		}
+	}
+};
+
+
+// Polyphonic drawbar and tilt CVs for the MicroHammond on the left
+struct VCOMHCV : Module {
+	enum ParamIds {
+		NUM_PARAMS
+	};
+	enum InputIds {
+		ENUMS(DRAWBAR_INPUT, NUM_DRAWBARS),
+		TILT_INPUT,
+		NUM_INPUTS
+	};
+	enum OutputIds {
+		NUM_OUTPUTS
+	};
+	enum LightIds {
+		CONNECTED_LIGHT,
+		NUM_LIGHTS
+	};
+
+	dsp::ClockDivider lightDivider;
+
+	VCOMHCV() {
+		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+		static const char* drawbarNames[NUM_DRAWBARS] = {"Sub", "Sub3", "Base", "Oct", "Harm3", "Oct2", "Harm5", "Harm6", "Oct3"};
+		for (int i = 0; i < NUM_DRAWBARS; i++) {
+			configInput(DRAWBAR_INPUT + i, string::f("%s drawbar", drawbarNames[i]));
+		}
+		configInput(TILT_INPUT, "Spectral tilt (3 dB/octave per volt)");
+		lightDivider.setDivision(512);
+	}
+
+	void process(const ProcessArgs& args) override {
+		Module* hammond = leftExpander.module;
+		bool connected = hammond && hammond->model == modelMicroHammond;
+		if (lightDivider.process()) {
+			lights[CONNECTED_LIGHT].setBrightness(connected);
+		}
+		if (!connected)
+			return;
+
+		VCOMHExpanderMessage* message = (VCOMHExpanderMessage*) hammond->rightExpander.producerMessage;
+		for (int i = 0; i < NUM_EXPANDER_CVS; i++) {
+			message->connected[i] = inputs[DRAWBAR_INPUT + i].isConnected();
+			if (!message->connected[i])
+				continue;
+			for (int c = 0; c < 16; c += 4) {
+				inputs[DRAWBAR_INPUT + i].getPolyVoltageSimd<float_4>(c).store(&message->voltages[i][c]);
+			}
+		}
+		hammond->rightExpander.messageFlipRequested = true;
+	}
+};
+
+
+struct VCOMHCVWidget : ModuleWidget {
+	VCOMHCVWidget(VCOMHCV* module) {
+		setModule(module);
+		setPanel(createPanel(asset::plugin(pluginInstance, "res/McHammondCV.svg")));
+
+		addChild(createWidget<ThemedScrew>(Vec(RACK_GRID_WIDTH, 0)));
+		addChild(createWidget<ThemedScrew>(Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
+
+		addChild(createLightCentered<SmallLight<GreenLight>>(mm2px(Vec(10.16, 12.0)), module, VCOMHCV::CONNECTED_LIGHT));
+
+		// Same order as the drawbar list in the README; the labels are in the panel SVG
+		for (int i = 0; i < NUM_EXPANDER_CVS; i++) {
+			Vec pos = mm2px(Vec(i % 2 == 0 ? 5.6 : 14.72, 26.0 + 19.0 * (i / 2)));
+			addInput(createInputCentered<ThemedPJ301MPort>(pos, module, VCOMHCV::DRAWBAR_INPUT + i));
+		}
 	}
 };
 
 
 Model* modelMicroHammond = createModel<VCOMH, VCOMHWidget>("MicroHammond");
+Model* modelMicroHammondCV = createModel<VCOMHCV, VCOMHCVWidget>("MicroHammondCV");
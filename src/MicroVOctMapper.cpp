@@ -1,48 +1,23 @@
 #include "plugin.hpp"
+#include "pitchgrid.hpp"
+#include "glide.hpp"
+#include "datalink.hpp"
 
 
 using simd::float_4;
-using simd::int32_4;
-
-class ConsistentTuning {
-	int a1, b1;
-	float f1, log2f1;
-	int a2, b2;
-	float f2, log2f2;
-	float det;
-public:
-	ConsistentTuning(int a1, int b1, float f1, int a2, int b2, float f2) {
-		this->setParams(a1, b1, f1, a2, b2, f2);
-	};
-	void setParams(int a1, int b1, float f1, int a2, int b2, float f2) {
-		this->a1 = a1;
-		this->b1 = b1;
-		this->f1 = f1;
-		this->a2 = a2;
-		this->b2 = b2;
-		this->f2 = f2;
-		this->det = a1 * b2 - a2 * b1;
-		assert(this->det != 0.f);
-		this->log2f1 = log2(f1);
-		this->log2f2 = log2(f2);
-	};
-	float vecToFreqRatio(int a, int b){
-		float z1 = (- this->a2 * b + this->b2 * a) / this->det;
-		float z2 = (this->a1 * b - this->b1 * a)  / this->det;
-		float f = pow(this->f1, z1) * pow(this->f2, z2);
-		return f;
-	};
-	float vecToVoltage(int a, int b){
-		float z1 = (- this->a2 * b + this->b2 * a) / this->det;
-		float z2 = (this->a1 * b - this->b1 * a)  / this->det;
-		float v = z1 * this->log2f1 + z2 * this->log2f2;
-		return v;
-	};
-
-
-};
-
 
+// Input layouts: keys per period, and the keys spanned by the small and the large diatonic step
+const int NUM_KEY_LAYOUTS = 6;
+const int KEY_LAYOUT_KEYS[NUM_KEY_LAYOUTS] = {7, 12, 17, 19, 22, 31};
+const int KEY_LAYOUT_STEPS[NUM_KEY_LAYOUTS][2] = {{1, 1}, {1, 2}, {1, 3}, {2, 3}, {1, 4}, {3, 5}};
+const int MAX_KEYS = 31;
+// Keys of 11 periods from 5 periods below C4 are mapped through a table, covering the MIDI range for 12 keys
+const int MAPPER_PERIODS = 11;
+const int MAPPER_LUT_SIZE = MAPPER_PERIODS * MAX_KEYS;
+// Quantizer pitches of one period plus a neighbour on each side, padded to a power of two for a branchless search
+const int QUANTIZER_TABLE_SIZE = 64;
+// Pitch wheel range of direct MIDI input, in keys
+const float MIDI_PITCH_BEND_RANGE = 2.f;
 
 struct VOctMapper : Module {
 	enum ParamIds {
@@ -52,10 +27,12 @@ struct VOctMapper : Module {
 	};
 	enum InputIds {
 		VOCT_INPUT,
+		TUNING_DATA_INPUT,
 		NUM_INPUTS
 	};
 	enum OutputIds {
 		MVOCT_OUTPUT,
+		GATE_OUTPUT,
 		NUM_OUTPUTS
 	};
 
@@ -68,6 +45,14 @@ struct VOctMapper : Module {
 		TUNING_7LIMIT_CLEANTONE = 5,
 		TUNING_19TET = 6,
 		TUNING_31TET = 7,
+		TUNING_SYNCED = 8
+	};
+
+	enum class InputModes : int {
+		INPUT_KEYBOARD = 0,
+		INPUT_QUANTIZE_SCALE = 1,
+		INPUT_QUANTIZE_KEYS = 2,
+		INPUT_CONTINUOUS = 3
 	};
 
 	enum class BlackKeyMapPresets : int {
@@ -79,25 +64,59 @@ struct VOctMapper : Module {
 		BLACKKEY_ALLSHARP = 5
 	};
 
-	int blackkey_diatonic_step_sequences[6][12] = {
-	//   C  Db D  Eb E  F  Gb G  Ab A  Bb B
-	//   C  Db D  Eb E  F  F# G  Ab A  Bb B
-	//   C  C# D  Eb E  F  F# G  Ab A  Bb B
-	//   C  C# D  Eb E  F  F# G  G# A  Bb B
-	//   C  C# D  D# E  F  F# G  G# A  Bb B
-	//   C  C# D  D# E  F  F# G  G# A  A# B
-		{0, 1, 1, 2, 2, 3, 4, 4, 5, 5, 6, 6},
-		{0, 1, 1, 2, 2, 3, 3, 4, 5, 5, 6, 6},
-		{0, 0, 1, 2, 2, 3, 3, 4, 5, 5, 6, 6},
-		{0, 0, 1, 2, 2, 3, 3, 4, 4, 5, 6, 6},
-		{0, 0, 1, 1, 2, 3, 3, 4, 4, 5, 6, 6},
-		{0, 0, 1, 1, 2, 3, 3, 4, 4, 5, 5, 6},
-	};
-
 	TuningPresets tuningPreset = TuningPresets::TUNING_12TET;
 	BlackKeyMapPresets blackKeyMapPreset = BlackKeyMapPresets::BLACKKEY_FSHARP;
-	ConsistentTuning tuning = ConsistentTuning(2, 5, 2.f, 1, 3, pow(2.f, 7.f/12.f)); // 12TET
-
+	// Index into KEY_LAYOUT_KEYS, 12 keys by default
+	int keyLayout = 1;
+	InputModes inputMode = InputModes::INPUT_KEYBOARD;
+	int hysteresis = 0;
+	ConsistentTuning tuning = ConsistentTuning({2, 5}, 2.f, {1, 3}, pow(2.f, 7.f/12.f)); // 12TET
+	RegularScale scale = RegularScale({2, 5}, 1);
+
+	TuningDataReceiver tuningDataReceiver;
+	// Raw values of the last TDAT frame, the tables are only rebuilt when they change
+	int tuningData[9] = {};
+	bool tuningFrameRed = true;
+	// Set while the TDAT input sends a scale system the piano layout cannot map
+	bool syncedScaleUnsupported = false;
+
+	// Lattice coordinate of each key of the period starting at C, and whether it is a natural
+	int numKeys = 12;
+	ScaleVector keyCoords[MAX_KEYS];
+	bool keyNaturals[MAX_KEYS] = {};
+	// Tuned voltage of each key for the current tuning, layout and black key map
+	int lutSize = 12 * MAPPER_PERIODS;
+	float lut[MAPPER_LUT_SIZE];
+	bool lutDirty = true;
+	// Continuous mode: monotone breakpoints through the tuned keys and the slope up to the next one
+	float warpPitches[MAPPER_LUT_SIZE];
+	float warpSlopes[MAPPER_LUT_SIZE];
+	// Input and output of each channel at the last sample, the input is NAN when invalidated
+	float_4 lastInput[4];
+	float lastOutput[16] = {};
+
+	// Quantizer: sorted tuned pitches within one period and the midpoints between them,
+	// the midpoints are padded with infinity
+	float quantizerPitches[QUANTIZER_TABLE_SIZE];
+	float quantizerBounds[QUANTIZER_TABLE_SIZE];
+	float quantizerPeriod = 1.f;
+
+	// Direct MIDI input, used while V/OCT is unpatched. Notes are taken at their frame, not per block.
+	midi::InputQueue midiInput;
+	int midiPolyphony = 8;
+	uint8_t midiNotes[16] = {};
+	bool midiGates[16] = {};
+	// Pulls the gate low when a held voice is retriggered, so envelopes see a new note
+	dsp::PulseGenerator midiRetriggers[16];
+	// Last voice assigned, new notes go to the next free voice after it
+	int midiRotateIndex = -1;
+	float midiPitchBend = 0.f;
+	float midiVoltages[16] = {};
+
+	// Portamento towards the tuned output, either in a fixed time per note or in a fixed time per period
+	GlideProcessor glide;
+	// Play the notes passed on the way instead of a continuous slide
+	bool glideSteps = false;
 
 	VOctMapper() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, 0);
@@ -106,9 +125,12 @@ struct VOctMapper : Module {
 		configParam(TUNING_FIFTH_PARAM, .375f, 1.125f, .75f, "Sub3 Freq", "ratio", 0.f, 100.f);
 
 		configInput(VOCT_INPUT, "1V/octave pitch");
+		configInput(TUNING_DATA_INPUT, "Tuning Data");
 
 		configOutput(MVOCT_OUTPUT, "Microtonally adjusted V/OCT pitch");
+		configOutput(GATE_OUTPUT, "MIDI gate");
 
+		tuningDataReceiver.initialize();
 
 	}
 
@@ -117,8 +139,26 @@ struct VOctMapper : Module {
 	}
 	void setBlackKeyMapPreset(int b){
 		blackKeyMapPreset = (BlackKeyMapPresets)b;
+		lutDirty = true;
+	}
 
-		// TODO: implement black key mapping
+	void setKeyLayout(int l) {
+		keyLayout = clamp(l, 0, NUM_KEY_LAYOUTS - 1);
+		lutDirty = true;
+	}
+
+	int getInputMode() {
+		return static_cast<int>(inputMode);
+	}
+	void setInputMode(int m) {
+		inputMode = (InputModes)m;
+		lutDirty = true;
+	}
+
+	// Hysteresis of the quantizer in volts
+	float getHysteresis() {
+		static const float cents[] = {0.f, 5.f, 10.f, 25.f};
+		return cents[clamp(hysteresis, 0, 3)] / 1200.f;
 	}
 
 	int getTuningPreset() {
@@ -129,73 +169,318 @@ struct VOctMapper : Module {
 
 		switch (tuningPreset) {
 			case TuningPresets::TUNING_12TET:
-				tuning.setParams(2, 5, 2.f, 1, 0, pow(2.f, 1.f/12.f));
+				tuning.setParams({2, 5}, 2.f, {1, 0}, pow(2.f, 1.f/12.f));
 				break;
 			case TuningPresets::TUNING_PYTHAGOREAN:
-				tuning.setParams(2, 5, 2.f, 1, 3, 3.f/2.f);
+				tuning.setParams({2, 5}, 2.f, {1, 3}, 3.f/2.f);
 				break;
 			case TuningPresets::TUNING_QUARTERCOMMA_MEANTONE:
-				tuning.setParams(2, 5, 2.f, 0, 2, 5.f/4.f);
+				tuning.setParams({2, 5}, 2.f, {0, 2}, 5.f/4.f);
 				break;
 			case TuningPresets::TUNING_THIRDCOMMA_MEANTONE:
-				tuning.setParams(2, 5, 2.f, 1, 1, 6.f/5.f);
+				tuning.setParams({2, 5}, 2.f, {1, 1}, 6.f/5.f);
 				break;
 			case TuningPresets::TUNING_HALFCOMMA_CLEANTONE:
-				tuning.setParams(0, 2, 5.f/4.f, 1, 3, 3.f/2.f);
+				tuning.setParams({0, 2}, 5.f/4.f, {1, 3}, 3.f/2.f);
 				break;
 			case TuningPresets::TUNING_7LIMIT_CLEANTONE:
-				tuning.setParams(1, 1, 7.f/6.f, 1, 3, 3.f/2.f);
+				tuning.setParams({1, 1}, 7.f/6.f, {1, 3}, 3.f/2.f);
 				break;
 			case TuningPresets::TUNING_19TET:
-				tuning.setParams(2, 5, 2.f, 1, 0, pow(2.f, 2.f/19.f));
+				tuning.setParams({2, 5}, 2.f, {1, 0}, pow(2.f, 2.f/19.f));
 				break;
 			case TuningPresets::TUNING_31TET:
-				tuning.setParams(2, 5, 2.f, 1, 0, pow(2.f, 3.f/31.f));
+				tuning.setParams({2, 5}, 2.f, {1, 0}, pow(2.f, 3.f/31.f));
 				break;
 			default:
 				break;
 		}
+		lutDirty = true;
+	}
+
+	// Takes the tuning of a completed TDAT frame if it differs from the last one. The key layouts are built on
+	// the diatonic {2, 5} system with C major on the naturals, so frames of other scale systems are refused.
+	// The mode of the frame does not move the naturals and is ignored.
+	void updateSyncedTuning() {
+		int data[9];
+		for (int i = 0; i < 9; i++) {
+			data[i] = tuningDataReceiver.getIntValue(i);
+		}
+		if (tuningPreset == TuningPresets::TUNING_SYNCED && std::equal(data, data + 9, tuningData))
+			return;
+		std::copy(data, data + 9, tuningData);
+		// Ignore frames that do not describe a tuning
+		ScaleVector v1 = {data[0], data[1]};
+		ScaleVector v2 = {data[3], data[4]};
+		if (IntegerDet(v1, v2) == 0 || !(tuningDataReceiver.getFloatValue(2) > 0.f) || !(tuningDataReceiver.getFloatValue(5) > 0.f))
+			return;
+		syncedScaleUnsupported = !(ScaleVector{data[6], data[7]} == ScaleVector{2, 5});
+		if (syncedScaleUnsupported)
+			return;
+		tuningDataReceiver.getTuningData(&tuning, &scale);
+		tuningPreset = TuningPresets::TUNING_SYNCED;
+		lutDirty = true;
+	}
+
+	static int floorDiv(int a, int b) {
+		return a >= 0 ? a / b : -((b - 1 - a) / b);
+	}
+
+	// The keys of a period take N consecutive notes of the chain of fifths, the naturals and as many
+	// flats and sharps as fit. The black key map moves the window from flats to sharps, for 12 keys
+	// it selects the black keys Db Eb Gb Ab Bb (all flat) up to C# D# F# G# A# (all sharp).
+	void updateKeyCoords() {
+		numKeys = KEY_LAYOUT_KEYS[keyLayout];
+		int smallStep = KEY_LAYOUT_STEPS[keyLayout][0];
+		int largeStep = KEY_LAYOUT_STEPS[keyLayout][1];
+		int accidentals = numKeys - 7;
+		int flats = clamp((accidentals + 1) / 2 + 2 - (int)blackKeyMapPreset, 0, accidentals);
+		// Fifths from C, F is -1 and B is 5
+		for (int j = -1 - flats; j < -1 - flats + numKeys; j++) {
+			ScaleVector coord = {j, 3 * j};
+			int steps = coord.x * smallStep + coord.y * largeStep;
+			int period = floorDiv(steps, numKeys);
+			int key = steps - period * numKeys;
+			keyCoords[key] = coord - ScaleVector{2, 5} * period;
+			keyNaturals[key] = j >= -1 && j <= 5;
+		}
+	}
+
+	// Tuned voltage of a key, counted from 5 periods below C4
+	float tuneKey(int key) {
+		int period = floorDiv(key, numKeys);
+		ScaleVector coord = keyCoords[key - period * numKeys] + ScaleVector{2, 5} * (period - 5);
+		return tuning.vecToVoltageNoOffset(coord);
+	}
+
+	void updateLut() {
+		updateKeyCoords();
+		lutSize = numKeys * MAPPER_PERIODS;
+		for (int n = 0; n < lutSize; n++) {
+			lut[n] = tuneKey(n);
+		}
+		updateWarp();
+		updateQuantizer();
+		for (int g = 0; g < 4; g++) {
+			lastInput[g] = NAN;
+		}
+		std::fill(lastOutput, lastOutput + 16, NAN);
+		glide.reset();
+		lutDirty = false;
+	}
+
+	void updateWarp() {
+		// A key tuned below its lower neighbour holds the neighbour's pitch, so bends never reverse
+		warpPitches[0] = lut[0];
+		for (int n = 1; n < lutSize; n++) {
+			warpPitches[n] = std::max(lut[n], warpPitches[n - 1]);
+			warpSlopes[n - 1] = warpPitches[n] - warpPitches[n - 1];
+		}
+		warpSlopes[lutSize - 1] = warpSlopes[lutSize - 2];
+	}
+
+	// Interpolates between the tuned keys, so bends and vibrato pass through.
+	// Beyond the table the outermost segments are extended.
+	float_4 warp(float_4 voltage) {
+		float_4 key = numKeys * (voltage + 5.f);
+		float_4 n = simd::clamp(simd::floor(key), 0.f, lutSize - 2.f);
+		float_4 pitch, slope;
+		for (int i = 0; i < 4; i++) {
+			pitch[i] = warpPitches[(int)n[i]];
+			slope[i] = warpSlopes[(int)n[i]];
+		}
+		return pitch + (key - n) * slope;
+	}
+
+	// Tuned pitches of the keys of the period from C4, or of the naturals only, reduced to one period
+	void updateQuantizer() {
+		quantizerPeriod = tuning.vecToVoltageNoOffset({2, 5});
+		float pitches[MAX_KEYS];
+		int n = 0;
+		for (int key = 0; key < numKeys; key++) {
+			if (inputMode == InputModes::INPUT_QUANTIZE_SCALE && !keyNaturals[key])
+				continue;
+			float pitch = lut[5 * numKeys + key];
+			pitches[n++] = pitch - std::floor(pitch / quantizerPeriod) * quantizerPeriod;
+		}
+		std::sort(pitches, pitches + n);
+
+		quantizerPitches[0] = pitches[n - 1] - quantizerPeriod;
+		std::copy(pitches, pitches + n, &quantizerPitches[1]);
+		quantizerPitches[n + 1] = pitches[0] + quantizerPeriod;
+		for (int i = 0; i < QUANTIZER_TABLE_SIZE; i++) {
+			quantizerBounds[i] = i <= n ? (quantizerPitches[i] + quantizerPitches[i + 1]) / 2.f : INFINITY;
+		}
+	}
+
+	// Nearest quantizer pitch in each lane, unless the last output is within the hysteresis of being as near
+	float_4 quantize(float_4 voltage, float_4 last) {
+		float_4 periods = simd::floor(voltage / quantizerPeriod);
+		float_4 x = voltage - periods * quantizerPeriod;
+		// Count the midpoints below x
+		float_4 index = 0.f;
+		for (int step = QUANTIZER_TABLE_SIZE / 2; step >= 1; step /= 2) {
+			float_4 bound;
+			for (int i = 0; i < 4; i++) {
+				bound[i] = quantizerBounds[(int)index[i] + step - 1];
+			}
+			index += (bound < x) & float_4(step);
+		}
+		float_4 nearest;
+		for (int i = 0; i < 4; i++) {
+			nearest[i] = quantizerPitches[(int)index[i]];
+		}
+		nearest += periods * quantizerPeriod;
+		float_4 keep = simd::fabs(voltage - last) <= simd::fabs(voltage - nearest) + getHysteresis();
+		return simd::ifelse(keep, last, nearest);
+	}
+
+	// Tuned voltage of the nearest key, with keys 1/N V apart and C4 at 0 V
+	float mapVoltage(float voltage) {
+		float key = clamp(roundf(numKeys * (voltage + 5.f)), -1e6f, 1e6f);
+		if (key >= 0.f && key < lutSize)
+			return lut[(int)key];
+		return tuneKey((int)key);
+	}
+
+	void processMidiMessage(const midi::Message& msg) {
+		switch (msg.getStatus()) {
+			// Note off
+			case 0x8: {
+				releaseMidiNote(msg.getNote());
+			} break;
+			// Note on
+			case 0x9: {
+				if (msg.getValue() > 0)
+					pressMidiNote(msg.getNote());
+				else
+					releaseMidiNote(msg.getNote());
+			} break;
+			// Pitch wheel
+			case 0xe: {
+				int value = ((int)msg.bytes[2] << 7) | msg.bytes[1];
+				midiPitchBend = (value - 8192) / 8192.f * MIDI_PITCH_BEND_RANGE;
+			} break;
+			// All sound off, all notes off
+			case 0xb: {
+				if (msg.getNote() == 120 || msg.getNote() == 123) {
+					std::fill(midiGates, midiGates + 16, false);
+				}
+			} break;
+			default: break;
+		}
+	}
+
+	void pressMidiNote(uint8_t note) {
+		int voice = -1;
+		// Retrigger a voice that still holds the note
+		for (int i = 0; i < midiPolyphony && voice < 0; i++) {
+			if (midiNotes[i] == note && midiGates[i])
+				voice = i;
+		}
+		for (int i = 1; i <= midiPolyphony && voice < 0; i++) {
+			int v = (midiRotateIndex + i) % midiPolyphony;
+			if (!midiGates[v])
+				voice = v;
+		}
+		// Steal the voice after the last one assigned
+		if (voice < 0)
+			voice = (midiRotateIndex + 1) % midiPolyphony;
+		if (midiGates[voice])
+			midiRetriggers[voice].trigger(1e-3f);
+		midiRotateIndex = voice;
+		midiNotes[voice] = note;
+		midiGates[voice] = true;
+	}
+
+	void releaseMidiNote(uint8_t note) {
+		for (int i = 0; i < midiPolyphony; i++) {
+			if (midiNotes[i] == note)
+				midiGates[i] = false;
+		}
+	}
 
+	void setMidiPolyphony(int polyphony) {
+		midiPolyphony = clamp(polyphony, 1, 16);
+		std::fill(midiGates, midiGates + 16, false);
+		midiRotateIndex = -1;
 	}
 
 	void process(const ProcessArgs& args) override {
 		//float fmParam = params[FM_PARAM].getValue();
 		
-		int channels = std::max(inputs[VOCT_INPUT].getChannels(), 1);
+		// Without a MIDI device an unpatched mapper still outputs one channel at 0 V
+		bool useMidi = !inputs[VOCT_INPUT].isConnected() && midiInput.getDeviceId() >= 0;
+		midi::Message msg;
+		while (midiInput.tryPop(&msg, args.frame)) {
+			processMidiMessage(msg);
+		}
+		if (useMidi) {
+			// Keys are counted from middle C, one key per MIDI note
+			for (int i = 0; i < midiPolyphony; i++) {
+				midiVoltages[i] = (midiNotes[i] - 60 + midiPitchBend) / numKeys;
+			}
+		}
+
+		int channels = useMidi ? midiPolyphony : std::max(inputs[VOCT_INPUT].getChannels(), 1);
+
+		if (inputs[TUNING_DATA_INPUT].isConnected()) {
+			tuningDataReceiver.processWithInput(&inputs[TUNING_DATA_INPUT]);
+			// The receiver swaps buffers at the end of each frame
+			if (tuningDataReceiver.processingRed != tuningFrameRed) {
+				tuningFrameRed = tuningDataReceiver.processingRed;
+				updateSyncedTuning();
+			}
+		}
+
+		if (lutDirty) {
+			updateLut();
+		}
 
 		for (int c = 0; c < channels; c += 4) {
-			float_4 standard_pitch = inputs[VOCT_INPUT].getPolyVoltageSimd<float_4>(c) + 5.f; // + 5 octaves
-			/*
-			def voltage2coordinates(v,r):
-				a=ceil(7*v-(r+5.5)/12)
-				b=floor(5*v+(r+5.5)/12)
-				a -= b
-				return a,b 
-			*/
-			int r = (int)blackKeyMapPreset;
-
-			int32_4 a = (int32_4)( ceil(7.f * standard_pitch - (r + 5.5f) / 12.f ) + .5f );
-			int32_4 b = (int32_4)( floor(5.f * standard_pitch + (r + 5.5f) / 12.f ) + .5f );
-			a -= b;
-
-			// - 5 octaves
-			a -= 10;
-			b -= 25;
-
-			float_4 voltage;
-			for (int i = 0; i < 4; i++){
-			 	voltage[i] = tuning.vecToVoltage(a[i], b[i]);
+			float_4 input = useMidi ? float_4::load(&midiVoltages[c]) : inputs[VOCT_INPUT].getPolyVoltageSimd<float_4>(c);
+			// Keyboard pitches are stepwise constant, so only channels whose input moved are mapped again
+			int changed = simd::movemask(input != lastInput[c / 4]);
+			if (changed && inputMode == InputModes::INPUT_KEYBOARD) {
+				for (int i = 0; i < 4; i++) {
+					if (changed & (1 << i))
+						lastOutput[c + i] = mapVoltage(input[i]);
+				}
+			}
+			else if (changed && inputMode == InputModes::INPUT_CONTINUOUS) {
+				warp(input).store(&lastOutput[c]);
+			}
+			else if (changed) {
+				// Unchanged lanes quantize to their last output again
+				quantize(input, float_4::load(&lastOutput[c])).store(&lastOutput[c]);
+			}
+			lastInput[c / 4] = input;
+
+			float_4 output = float_4::load(&lastOutput[c]);
+			if (glide.isEnabled()) {
+				float_4 target = output;
+				output = glide.process(c / 4, target, quantizerPeriod, args.sampleTime);
+				if (glideSteps)
+					output = simd::ifelse(output == target, target, quantize(output, NAN));
 			}
 
 			// Set output
 			if (outputs[MVOCT_OUTPUT].isConnected()){
-				outputs[MVOCT_OUTPUT].setVoltageSimd(voltage, c);
+				outputs[MVOCT_OUTPUT].setVoltageSimd(output, c);
 			}
 
 		}
 
 		outputs[MVOCT_OUTPUT].setChannels(channels);
 
+		if (useMidi) {
+			for (int i = 0; i < channels; i++) {
+				bool retrigger = midiRetriggers[i].process(args.sampleTime);
+				outputs[GATE_OUTPUT].setVoltage(midiGates[i] && !retrigger ? 10.f : 0.f, i);
+			}
+		}
+		outputs[GATE_OUTPUT].setChannels(useMidi ? channels : 0);
+
 	}
 
 
@@ -203,16 +488,42 @@ struct VOctMapper : Module {
 		json_t* rootJ = json_object();
 		json_object_set_new(rootJ, "blackKeyMapPreset", json_integer((int)blackKeyMapPreset));
 		json_object_set_new(rootJ, "tuningPreset", json_integer((int)tuningPreset));
+		json_object_set_new(rootJ, "keyLayout", json_integer(keyLayout));
+		json_object_set_new(rootJ, "inputMode", json_integer((int)inputMode));
+		json_object_set_new(rootJ, "hysteresis", json_integer(hysteresis));
+		glide.dataToJson(rootJ);
+		json_object_set_new(rootJ, "glideSteps", json_boolean(glideSteps));
+		json_object_set_new(rootJ, "midi", midiInput.toJson());
+		json_object_set_new(rootJ, "midiPolyphony", json_integer(midiPolyphony));
 		return rootJ;
 	}
 
 	void dataFromJson(json_t* rootJ) override {
 		json_t* blackKeyMapPresetJ = json_object_get(rootJ, "blackKeyMapPreset");
 		if (blackKeyMapPresetJ)
-			blackKeyMapPreset = (BlackKeyMapPresets)json_integer_value(blackKeyMapPresetJ);
+			setBlackKeyMapPreset(json_integer_value(blackKeyMapPresetJ));
 		json_t* tuningPresetJ = json_object_get(rootJ, "tuningPreset");
 		if (tuningPresetJ)
-			tuningPreset = (TuningPresets)json_integer_value(tuningPresetJ);
+			setTuningPreset(json_integer_value(tuningPresetJ));
+		json_t* keyLayoutJ = json_object_get(rootJ, "keyLayout");
+		if (keyLayoutJ)
+			setKeyLayout(json_integer_value(keyLayoutJ));
+		json_t* inputModeJ = json_object_get(rootJ, "inputMode");
+		if (inputModeJ)
+			setInputMode(json_integer_value(inputModeJ));
+		json_t* hysteresisJ = json_object_get(rootJ, "hysteresis");
+		if (hysteresisJ)
+			hysteresis = json_integer_value(hysteresisJ);
+		glide.dataFromJson(rootJ);
+		json_t* glideStepsJ = json_object_get(rootJ, "glideSteps");
+		if (glideStepsJ)
+			glideSteps = json_boolean_value(glideStepsJ);
+		json_t* midiJ = json_object_get(rootJ, "midi");
+		if (midiJ)
+			midiInput.fromJson(midiJ);
+		json_t* midiPolyphonyJ = json_object_get(rootJ, "midiPolyphony");
+		if (midiPolyphonyJ)
+			setMidiPolyphony(json_integer_value(midiPolyphonyJ));
 	}
 
 };
@@ -221,7 +532,10 @@ struct VOctTuningDisplay: TuningDisplay {
 	VOctMapper* module;
 	void step() override {
 		text = "12-TET";
-		if(module){
+		if (module && module->syncedScaleUnsupported && module->inputs[VOctMapper::InputIds::TUNING_DATA_INPUT].isConnected()) {
+			text = "SYNC (needs a 7 note scale)";
+		}
+		else if(module){
 			text = module->tuningPreset == VOctMapper::TuningPresets::TUNING_12TET ? "12-TET" :
 				module->tuningPreset == VOctMapper::TuningPresets::TUNING_PYTHAGOREAN ? "Pythagorean" :
 				module->tuningPreset == VOctMapper::TuningPresets::TUNING_QUARTERCOMMA_MEANTONE ? "1/4-comma Meantone" :
@@ -229,7 +543,11 @@ struct VOctTuningDisplay: TuningDisplay {
 				module->tuningPreset == VOctMapper::TuningPresets::TUNING_HALFCOMMA_CLEANTONE ? "1/2-comma Cleantone" :
 				module->tuningPreset == VOctMapper::TuningPresets::TUNING_7LIMIT_CLEANTONE ? "7-limit (m3=7/6 P5=3/2)" :
 				module->tuningPreset == VOctMapper::TuningPresets::TUNING_19TET ? "19-TET" :
-				module->tuningPreset == VOctMapper::TuningPresets::TUNING_31TET ? "31-TET" : "Unknown";
+				module->tuningPreset == VOctMapper::TuningPresets::TUNING_31TET ? "31-TET" :
+				module->tuningPreset == VOctMapper::TuningPresets::TUNING_SYNCED ? (
+					module->inputs[VOctMapper::InputIds::TUNING_DATA_INPUT].isConnected() ? "SYNC": "SYNCED (disconnected)"
+				) :
+				"Unknown";
 		}
 	};
 };
@@ -324,8 +642,10 @@ struct VOctMapperWidget : ModuleWidget {
 		addChild(createWidget<ThemedScrew>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
 
 		addInput(createInputCentered<ThemedPJ301MPort>(mm2px(Vec(6.607, 113.115)), module, VOctMapper::VOCT_INPUT));
+		addInput(createInputCentered<ThemedPJ301MPort>(mm2px(Vec(39.15, 96.859)), module, VOctMapper::TUNING_DATA_INPUT));
 
 		addOutput(createOutputCentered<ThemedPJ301MPort>(mm2px(Vec(39.15, 113.115)), module, VOctMapper::MVOCT_OUTPUT));
+		addOutput(createOutputCentered<ThemedPJ301MPort>(mm2px(Vec(28.282, 113.115)), module, VOctMapper::GATE_OUTPUT));
 
 		VOctTuningDisplay* display = createWidget<VOctTuningDisplay>(mm2px(Vec(2.0, 80.0)));
 		display->box.size = mm2px(Vec(42, 7));
@@ -345,6 +665,53 @@ struct VOctMapperWidget : ModuleWidget {
 
 		menu->addChild(new MenuSeparator);
 
+		menu->addChild(createIndexSubmenuItem("Keys per period",
+			{
+				"7 (naturals)",
+				"12 (piano)",
+				"17",
+				"19",
+				"22",
+				"31",
+			},
+			[=]() {
+				return module->keyLayout;
+			},
+			[=](int layout) {
+				module->setKeyLayout(layout);
+			}
+		));
+
+		menu->addChild(createIndexSubmenuItem("Input",
+			{
+				"Keyboard (1/N V per key)",
+				"Quantize to scale",
+				"Quantize to all keys",
+				"Continuous (keeps pitch bend)",
+			},
+			[=]() {
+				return module->getInputMode();
+			},
+			[=](int mode) {
+				module->setInputMode(mode);
+			}
+		));
+
+		menu->addChild(createIndexSubmenuItem("Quantizer hysteresis",
+			{
+				"Off",
+				"5 cents",
+				"10 cents",
+				"25 cents",
+			},
+			[=]() {
+				return module->hysteresis;
+			},
+			[=](int h) {
+				module->hysteresis = h;
+			}
+		));
+
 		menu->addChild(createIndexSubmenuItem("Black key mapping",
 			{
 				"All flat (Gb)",
@@ -380,6 +747,23 @@ struct VOctMapperWidget : ModuleWidget {
 				module->setTuningPreset(tuning);
 			}
 		));
+
+		module->glide.appendContextMenu(menu);
+		menu->addChild(createBoolPtrMenuItem("Glide through notes", "", &module->glideSteps));
+
+		menu->addChild(new MenuSeparator);
+		menu->addChild(createMenuLabel("MIDI input, used while V/OCT is unpatched"));
+		appendMidiMenu(menu, &module->midiInput);
+
+		menu->addChild(createIndexSubmenuItem("Polyphony",
+			{"1", "2", "3", "4", "5", "6", "7", "8", "9", "10", "11", "12", "13", "14", "15", "16"},
+			[=]() {
+				return module->midiPolyphony - 1;
+			},
+			[=](int i) {
+				module->setMidiPolyphony(i + 1);
+			}
+		));
 	}
 };
 
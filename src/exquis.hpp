@@ -1,4 +1,8 @@
 #include <rack.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 using namespace rack;
 
 #include "integer_linalg.hpp"
@@ -197,6 +201,319 @@ struct ExquisBreathingNote {
 };
 
 
+// Short message queued for the Exquis MIDI worker, long enough for the dev mode and set color messages
+struct ExquisShortMessage {
+	uint8_t size = 0;
+	uint8_t bytes[12];
+};
+
+// Owns the MIDI output to the Exquis on a worker thread. The audio thread only queues short messages
+// and publishes the pad state; the worker coalesces pad updates into the fewest bytes and writes to the driver.
+struct ExquisMidiWorker {
+	midi::Output* output = NULL;
+	dsp::RingBuffer<ExquisShortMessage, 256> queue;
+
+	// Device requested by the audio thread, applied by the worker before the next write. Every request
+	// bumps the generation, so that the same ids requested again reopen the port.
+	std::atomic<int> driverId{-1};
+	std::atomic<int> deviceId{-1};
+	std::atomic<int> deviceGeneration{0};
+	int outputGeneration = 0;
+	int outputDriverId = -1;
+
+	// Latest pad state from the audio thread, guarded by padsMutex
+	std::mutex padsMutex;
+	uint8_t pendingMidinotes[61];
+	Color pendingColors[61];
+	std::atomic<bool> padsPending{false};
+	bool resendPending = false;
+
+	// Pad state as last sent to the device, worker thread only
+	uint8_t sentMidinotes[61];
+	Color sentColors[61];
+	bool sentValid = false;
+
+	std::atomic<bool> running{false};
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable cv;
+
+	~ExquisMidiWorker(){
+		if (running){
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				running = false;
+			}
+			cv.notify_one();
+			thread.join();
+		}
+	}
+
+	// Called once the output is set, before the audio thread uses the worker
+	void start(){
+		if (!running){
+			running = true;
+			thread = std::thread([this](){ run(); });
+		}
+	}
+
+	// Called from the audio thread. The worker only holds the lock to check for work, so notifying under
+	// it is short and makes sure the wakeup is not lost between that check and the wait.
+	void wake(){
+		std::lock_guard<std::mutex> lock(mutex);
+		cv.notify_one();
+	}
+
+	// Called from the audio thread, a device id of -1 closes the port
+	void setDevice(int driverId, int deviceId){
+		this->driverId = driverId;
+		this->deviceId = deviceId;
+		deviceGeneration++;
+		wake();
+	}
+
+	// Called from the audio thread, drops the message if the worker has fallen that far behind
+	void send(std::initializer_list<uint8_t> bytes){
+		if (queue.full() || bytes.size() > sizeof(ExquisShortMessage::bytes)){
+			return;
+		}
+		ExquisShortMessage msg;
+		msg.size = bytes.size();
+		std::copy(bytes.begin(), bytes.end(), msg.bytes);
+		queue.push(msg);
+		wake();
+	}
+
+	// Called from the audio thread. Returns false without waiting if the worker is reading the
+	// previous state, in which case the caller tries again on its next display update.
+	bool publishPads(const std::vector<ExquisNote>& notes, bool resend){
+		std::unique_lock<std::mutex> lock(padsMutex, std::try_to_lock);
+		if (!lock.owns_lock()){
+			return false;
+		}
+		for (int i = 0; i < 61; i++){
+			pendingMidinotes[i] = notes[i].midinote;
+			pendingColors[i] = notes[i].shownColor;
+		}
+		padsPending = true;
+		resendPending = resendPending || resend;
+		lock.unlock();
+		wake();
+		return true;
+	}
+
+	void run(){
+		while (running){
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				cv.wait(lock, [this](){ return !queue.empty() || padsPending || deviceGeneration != outputGeneration || !running; });
+			}
+			flush(running);
+		}
+		// Deliver what was queued before shutdown, such as the exit dev mode message
+		flush(false);
+	}
+
+	void flush(bool withPads){
+		int generation = deviceGeneration;
+		if (generation != outputGeneration){
+			outputGeneration = generation;
+			// Close first, a device that was unplugged and came back under the same ids needs a fresh port
+			output->setDeviceId(-1);
+			int newDriverId = driverId;
+			int newDeviceId = deviceId;
+			if (newDriverId >= 0 && newDriverId != outputDriverId){
+				outputDriverId = newDriverId;
+				output->setDriverId(outputDriverId);
+			}
+			if (newDeviceId >= 0){
+				output->setDeviceId(newDeviceId);
+			}
+			// The device may have lost its pads, the next update sends a full snapshot
+			sentValid = false;
+		}
+		while (!queue.empty()){
+			ExquisShortMessage m = queue.shift();
+			midi::Message msg;
+			msg.bytes = std::vector<uint8_t>(m.bytes, m.bytes + m.size);
+			output->sendMessage(msg);
+		}
+		if (!withPads){
+			return;
+		}
+		uint8_t midinotes[61];
+		Color colors[61];
+		bool resend;
+		{
+			std::lock_guard<std::mutex> lock(padsMutex);
+			if (!padsPending){
+				return;
+			}
+			memcpy(midinotes, pendingMidinotes, sizeof(midinotes));
+			std::copy(pendingColors, pendingColors + 61, colors);
+			resend = resendPending;
+			padsPending = false;
+			resendPending = false;
+		}
+		sendPads(midinotes, colors, resend);
+	}
+
+	// Sends the pads whose color changed since the last update as runs of set color messages
+	// (8 bytes plus 4 per pad). Short gaps between changed pads are resent rather than starting
+	// a new message. Falls back to the snapshot when that is shorter or midinotes need to be sent.
+	void sendPads(const uint8_t* midinotes, const Color* colors, bool resend){
+		if (resend || !sentValid || memcmp(midinotes, sentMidinotes, sizeof(sentMidinotes)) != 0){
+			sendCustomSnapshotMessage(midinotes, colors);
+			return;
+		}
+		int runStart[61];
+		int runEnd[61];
+		int numRuns = 0;
+		int bytes = 0;
+		for (int i = 0; i < 61; i++){
+			if (colors[i] == sentColors[i]){
+				continue;
+			}
+			if (numRuns > 0 && i - runEnd[numRuns - 1] <= 3){
+				bytes += 4 * (i - runEnd[numRuns - 1]);
+				runEnd[numRuns - 1] = i;
+			}else{
+				runStart[numRuns] = i;
+				runEnd[numRuns] = i;
+				numRuns++;
+				bytes += 12;
+			}
+		}
+		if (bytes >= 262){
+			sendCustomSnapshotMessage(midinotes, colors);
+			return;
+		}
+
+		for (int r = 0; r < numRuns; r++){
+			// `F0 00 21 7E 7F 04 start_id color(0) [... color(N)] F7`
+			midi::Message msg;
+			msg.bytes = {0xF0, 0x00, 0x21, 0x7E, 0x7F, 0x04, uint8_t(runStart[r])};
+			for (int i = runStart[r]; i <= runEnd[r]; i++){
+				msg.bytes.insert(msg.bytes.end(), {colors[i].r, colors[i].g, colors[i].b, 0x00});
+				sentColors[i] = colors[i];
+			}
+			msg.bytes.push_back(0xF7);
+			output->sendMessage(msg);
+		}
+	}
+
+	void sendCustomSnapshotMessage(const uint8_t* midinotes, const Color* colors){
+		// 17 + 61 * 4 + 1 = 262
+		uint8_t msg[262];
+		// header (17 bytes):  F0 00 21 7E 7F 09 00 01 01 0E 00 00 01 01 00 00 00
+
+		// Meaning
+		//                                                                     |PBRange
+		//                                                                     |
+		uint8_t msg_start[] = {0xF0, 0x00, 0x21, 0x7E, 0x7F, 0x09, 0x00, 0x01, 0x00, 0x0E, 0x00, 0x00, 0x01, 0x01, 0x00, 0x00, 0x00};
+		memcpy(msg, msg_start, sizeof(msg_start));
+		for (int i = 0; i < 61; i++){
+			msg[17 + 4*i] = midinotes[i];
+			msg[18 + 4*i] = colors[i].r;
+			msg[19 + 4*i] = colors[i].g;
+			msg[20 + 4*i] = colors[i].b;
+			sentMidinotes[i] = midinotes[i];
+			sentColors[i] = colors[i];
+		}
+		// end byte: F7
+		msg[261] = 0xF7;
+
+		midi::Message midi_msg;
+		midi_msg.bytes = std::vector<uint8_t>(msg, msg + 262);
+		output->sendMessage(midi_msg);
+		sentValid = true;
+	}
+};
+
+
+// MIDI driver and device ids of the Exquis ports, -1 where no Exquis was found
+struct ExquisDeviceIds {
+	int inputDriverId = -1;
+	int inputDeviceId = -1;
+	int outputDriverId = -1;
+	int outputDeviceId = -1;
+
+	// Packs the ids into one word so they can be published with a single atomic store
+	uint64_t pack() const {
+		return uint64_t(uint16_t(inputDriverId)) | uint64_t(uint16_t(inputDeviceId)) << 16
+			| uint64_t(uint16_t(outputDriverId)) << 32 | uint64_t(uint16_t(outputDeviceId)) << 48;
+	}
+	static ExquisDeviceIds unpack(uint64_t p){
+		ExquisDeviceIds ids;
+		ids.inputDriverId = int16_t(p);
+		ids.inputDeviceId = int16_t(p >> 16);
+		ids.outputDriverId = int16_t(p >> 32);
+		ids.outputDeviceId = int16_t(p >> 48);
+		return ids;
+	}
+
+	// Enumerates all MIDI drivers for devices named Exquis, which can take milliseconds on some drivers
+	static ExquisDeviceIds find(){
+		ExquisDeviceIds ids;
+		for (int driver_id : midi::getDriverIds()){
+			midi::Driver* driver = midi::getDriver(driver_id);
+			for (int device_id : driver->getOutputDeviceIds()){
+				if (driver->getOutputDeviceName(device_id).rfind( "Exquis", 0)==0){
+					ids.outputDriverId = driver_id;
+					ids.outputDeviceId = device_id;
+				}
+			}
+			for (int device_id : driver->getInputDeviceIds()){
+				if (driver->getInputDeviceName(device_id).rfind( "Exquis", 0)==0){
+					ids.inputDriverId = driver_id;
+					ids.inputDeviceId = device_id;
+					return ids;
+				}
+			}
+		}
+		return ids;
+	}
+};
+
+// Looks for the Exquis on a background thread every 2 seconds while it is missing and every 5 seconds
+// while it is connected, and publishes the result for the audio thread to pick up.
+struct ExquisDeviceWatcher {
+	std::atomic<uint64_t> found{ExquisDeviceIds().pack()};
+
+	std::atomic<bool> running{false};
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable cv;
+
+	~ExquisDeviceWatcher(){
+		if (running){
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				running = false;
+			}
+			cv.notify_one();
+			thread.join();
+		}
+	}
+
+	void start(){
+		if (!running){
+			running = true;
+			thread = std::thread([this](){ run(); });
+		}
+	}
+
+	void run(){
+		while (running){
+			ExquisDeviceIds ids = ExquisDeviceIds::find();
+			found = ids.pack();
+			std::unique_lock<std::mutex> lock(mutex);
+			cv.wait_for(lock, std::chrono::seconds(ids.inputDeviceId >= 0 ? 5 : 2), [this](){ return !running; });
+		}
+	}
+};
+
+
 struct Exquis {
 	std::vector<ExquisNote> notes;
 	midi::Output midi_output;
@@ -205,6 +522,11 @@ struct Exquis {
     bool needsNoteDisplayUpdate = true;
     bool needsMidinoteValuesUpdate = true;
 
+	// Writes to midi_output; declared after it so that it is stopped first
+	ExquisMidiWorker midiWorker;
+	ExquisDeviceWatcher deviceWatcher;
+	uint64_t deviceIds = ExquisDeviceIds().pack();
+
     dsp::ClockDivider xqNoteDisplayUpdateClock;
 
     ExquisBreathingNote tuningRetuneNote;
@@ -222,17 +544,25 @@ struct Exquis {
         tuningRetuneNote.config(&midi_output, true);
         tuningConstantNote.config(&midi_output, false);
         selectedScaleNote.config(&midi_output, true);
+
+        midiWorker.output = &midi_output;
+        midiWorker.start();
 	}
 
     virtual void processMidiMessage(midi::Message msg){
         // override this
     }
+    // called once per sample after the incoming messages have been processed
+    virtual void processPendingUpdates(){
+        // override this
+    }
 
     void process(const rack::engine::Module::ProcessArgs& args){
         midi::Message msg;
         while (midi_input.tryPop(&msg, args.frame)) {
             processMidiMessage(msg);
         }
+        processPendingUpdates();
 
         if (xqNoteDisplayUpdateClock.process()){
             if (needsNoteDisplayUpdate){
@@ -257,7 +587,7 @@ struct Exquis {
             needsNoteDisplayUpdate = true;
             //return;
         }
-		sendCustomSnapshotMessage();
+		publishPads(false);
 		//for (ExquisNote& note : notes){
         //    note.sendSetColorMessage(&midi_output, note.color * note.brightness);
 		//}
@@ -267,65 +597,54 @@ struct Exquis {
             needsMidinoteValuesUpdate = true;
             return;
         }
-		sendCustomSnapshotMessage();
+		publishPads(true);
 	}
 
-	void sendCustomSnapshotMessage(){
-	
-		// 17 + 61 * 4 + 1 = 262
-		uint8_t msg[262];
-		// header (17 bytes):  F0 00 21 7E 7F 09 00 01 01 0E 00 00 01 01 00 00 00
-
-		// Meaning
-		//                                                                     |PBRange
-		//                                                                     |
-		uint8_t msg_start[] = {0xF0, 0x00, 0x21, 0x7E, 0x7F, 0x09, 0x00, 0x01, 0x00, 0x0E, 0x00, 0x00, 0x01, 0x01, 0x00, 0x00, 0x00};
-		memcpy(msg, msg_start, sizeof(msg_start));
-		for (int i = 0; i < 61; i++){
-			ExquisNote* note = &notes[i];
-			msg[17 + 4*i] = note->midinote;
-			note->shownColor = note->functionEnabled ? note->functionColor : (note->color * note->brightness);
-			msg[18 + 4*i] = note->shownColor.r;
-			msg[19 + 4*i] = note->shownColor.g;
-			msg[20 + 4*i] = note->shownColor.b;
-			
+	// Hands the pad state to the MIDI worker, which sends only what changed unless a full snapshot is requested
+	void publishPads(bool snapshot){
+		for (ExquisNote& note : notes){
+			note.shownColor = note.functionEnabled ? note.functionColor : (note.color * note.brightness);
+		}
+		snapshot = snapshot || needsMidinoteValuesUpdate;
+		if (midiWorker.publishPads(notes, snapshot)){
+			needsMidinoteValuesUpdate = false;
+		}else{
+			needsNoteDisplayUpdate = true;
+			needsMidinoteValuesUpdate = snapshot;
 		}
-		// end byte: F7
-		msg[261] = 0xF7;
-		
-		midi::Message midi_msg;
-		//midi_msg.bytes.resize(262);
-		//memcpy(midi_msg.bytes.data(), msg, 262);
-
-		midi_msg.bytes = std::vector<uint8_t>(msg, msg + 262);
-		midi_output.sendMessage(midi_msg);
 	}
 
+	// Looks for the Exquis right away, for use outside the audio thread
 	void checkConnection(){
 		//INFO("Checking MIDI -> Exquis connection...");
-		for (int driver_id : midi::getDriverIds()){
-			midi::Driver* driver = midi::getDriver(driver_id);
-			for (int device_id : driver->getOutputDeviceIds()){
-				// print device name
-				//INFO("Output device: %s", driver->getOutputDeviceName(device_id).c_str());
-				if (driver->getOutputDeviceName(device_id).rfind( "Exquis", 0)==0){
-					midi_output.setDriverId(driver_id);
-					midi_output.setDeviceId(device_id);
-					continue;
-				}
-			}
-			for (int device_id : driver->getInputDeviceIds()){
-				// print device name
-				//INFO("Input device: %s", driver->getInputDeviceName(device_id).c_str());
-				if (driver->getInputDeviceName(device_id).rfind( "Exquis", 0)==0){
-					midi_input.setDriverId(driver_id);
-					midi_input.setDeviceId(device_id);
-					connected = true;
-					return;
-				}
-			}
+		setDevice(ExquisDeviceIds::find().pack());
+		deviceWatcher.found = deviceIds;
+	}
+	// Picks up the latest result of the background device watcher. Returns true when the Exquis was just connected.
+	bool pollConnection(){
+		uint64_t ids = deviceWatcher.found;
+		if (ids == deviceIds){
+			return false;
+		}
+		bool wasConnected = connected;
+		setDevice(ids);
+		return connected && !wasConnected;
+	}
+	void setDevice(uint64_t packedIds){
+		ExquisDeviceIds ids = ExquisDeviceIds::unpack(packedIds);
+		ExquisDeviceIds last = ExquisDeviceIds::unpack(deviceIds);
+		deviceIds = packedIds;
+		midiWorker.setDevice(ids.outputDriverId, ids.outputDeviceId);
+		connected = ids.inputDeviceId >= 0;
+		if (!connected){
+			return;
+		}
+		if (ids.inputDriverId != last.inputDriverId){
+			midi_input.setDriverId(ids.inputDriverId);
+			midi_input.setDeviceId(ids.inputDeviceId);
+		}else if (ids.inputDeviceId != last.inputDeviceId){
+			midi_input.setDeviceId(ids.inputDeviceId);
 		}
-		connected = false;
 	}
 	//void sendKeepaliveMessage() {
 	//	midi::Message msg;
@@ -334,19 +653,13 @@ struct Exquis {
 	//	midi_output.sendMessage(msg);
 	//}
 	void sendEnterDevModeMessage(){
-		midi::Message msg;
-		msg.bytes = {0xF0, 0x00, 0x21, 0x7E, 0x7F, 0x00, 0x3A, 0xF7}; // 0x3A is a bitmask, 0x02 pads, 0x08 up/down buttons, 0x10 settings&sound buttons, 0x20 other buttons
-		midi_output.sendMessage(msg);
+		midiWorker.send({0xF0, 0x00, 0x21, 0x7E, 0x7F, 0x00, 0x3A, 0xF7}); // 0x3A is a bitmask, 0x02 pads, 0x08 up/down buttons, 0x10 settings&sound buttons, 0x20 other buttons
 	}
 	void sendExitDevModeMessage(){
-		midi::Message msg;
-		msg.bytes = {0xF0, 0x00, 0x21, 0x7E, 0x7F, 0x00, 0x00, 0xF7};
-		midi_output.sendMessage(msg);
+		midiWorker.send({0xF0, 0x00, 0x21, 0x7E, 0x7F, 0x00, 0x00, 0xF7});
 	}
 	void sendSetColorMessage(uint8_t noteId, Color color){
-		midi::Message msg;
-		msg.bytes = {0xF0, 0x00, 0x21, 0x7E, 0x7F, 0x04, noteId, color.r, color.g, color.b, 0x00, 0xF7};
-		midi_output.sendMessage(msg);
+		midiWorker.send({0xF0, 0x00, 0x21, 0x7E, 0x7F, 0x04, noteId, color.r, color.g, color.b, 0x00, 0xF7});
 	}
 
 
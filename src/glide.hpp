@@ -0,0 +1,100 @@
+#pragma once
+#include <rack.hpp>
+using namespace rack;
+using simd::float_4;
+
+// Portamento of up to 16 pitch voltages, shared by the modules with a glide menu
+struct GlideProcessor {
+	enum class GlideModes : int {
+		GLIDE_OFF = 0,
+		GLIDE_CONSTANT_TIME = 1,
+		GLIDE_CONSTANT_RATE = 2
+	};
+
+	GlideModes mode = GlideModes::GLIDE_OFF;
+	int time = 1;
+	float_4 voltage[4];
+	float_4 target[4];
+	float_4 rate[4] = {};
+
+	GlideProcessor() {
+		reset();
+	}
+
+	void reset() {
+		for (int g = 0; g < 4; g++) {
+			voltage[g] = NAN;
+			target[g] = NAN;
+		}
+	}
+
+	bool isEnabled() {
+		return mode != GlideModes::GLIDE_OFF;
+	}
+
+	float getTime() {
+		static const float times[] = {0.05f, 0.2f, 1.f};
+		return times[clamp(time, 0, 2)];
+	}
+
+	// Moves four channels towards their targets by one sample. At constant rate a glide lasts the selected time per period.
+	float_4 process(int g, float_4 newTarget, float period, float sampleTime) {
+		float_4& v = voltage[g];
+		float_4 retarget = newTarget != target[g];
+		if (simd::movemask(retarget)) {
+			float t = getTime();
+			float_4 newRate = mode == GlideModes::GLIDE_CONSTANT_TIME ? simd::fabs(newTarget - v) / t : float_4(period / t);
+			rate[g] = simd::ifelse(retarget, newRate, rate[g]);
+			target[g] = newTarget;
+		}
+		float_4 step = rate[g] * sampleTime;
+		float_4 delta = newTarget - v;
+		v = simd::ifelse(simd::fabs(delta) <= step, newTarget, v + simd::clamp(delta, -step, step));
+		// Channels without a previous note start at their target
+		v = simd::ifelse(v != v, newTarget, v);
+		return v;
+	}
+
+	void dataToJson(json_t* rootJ) {
+		json_object_set_new(rootJ, "glideMode", json_integer((int)mode));
+		json_object_set_new(rootJ, "glideTime", json_integer(time));
+	}
+
+	void dataFromJson(json_t* rootJ) {
+		json_t* modeJ = json_object_get(rootJ, "glideMode");
+		if (modeJ)
+			mode = (GlideModes)json_integer_value(modeJ);
+		json_t* timeJ = json_object_get(rootJ, "glideTime");
+		if (timeJ)
+			time = json_integer_value(timeJ);
+	}
+
+	void appendContextMenu(Menu* menu) {
+		menu->addChild(createIndexSubmenuItem("Glide",
+			{
+				"Off",
+				"Constant time",
+				"Constant rate",
+			},
+			[=]() {
+				return (int)mode;
+			},
+			[=](int m) {
+				mode = (GlideModes)m;
+			}
+		));
+		menu->addChild(createIndexSubmenuItem("Glide time (per period at constant rate)",
+			{
+				"50 ms",
+				"200 ms",
+				"1 s",
+			},
+			[=]() {
+				return time;
+			},
+			[=](int t) {
+				time = t;
+			}
+		));
+	}
+};
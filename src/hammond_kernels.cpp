@@ -0,0 +1,230 @@
+#include "hammond_kernels.hpp"
+#include <chrono>
+
+using rack::simd::float_4;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+
+// The plugin is built for the baseline instruction set, so the wide kernels are compiled per function
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+
+
+// 8 wide: two partials of four voices per register
+
+TARGET_AVX2 static inline __m256 load8(const float_4* a, const int* p) {
+	__m128 hi = p[1] >= 0 ? a[p[1]].v : _mm_setzero_ps();
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(a[p[0]].v), hi, 1);
+}
+
+TARGET_AVX2 static inline void store8(float_4* a, const int* p, __m256 v) {
+	a[p[0]].v = _mm256_castps256_ps128(v);
+	if (p[1] >= 0)
+		a[p[1]].v = _mm256_extractf128_ps(v, 1);
+}
+
+TARGET_AVX2 static inline __m256 sin2piQuadratic8(__m256 x) {
+	__m256 half = _mm256_cmp_ps(x, _mm256_set1_ps(0.5f), _CMP_LT_OQ);
+	__m256 y = _mm256_sub_ps(x, _mm256_blendv_ps(_mm256_set1_ps(0.75f), _mm256_set1_ps(0.25f), half));
+	__m256 v = _mm256_fnmadd_ps(_mm256_mul_ps(_mm256_set1_ps(16.f), y), y, _mm256_set1_ps(1.f));
+	return _mm256_blendv_ps(_mm256_sub_ps(_mm256_setzero_ps(), v), v, half);
+}
+
+TARGET_AVX2 static inline __m256 sin2piPade54_8(__m256 x) {
+	x = _mm256_sub_ps(x, _mm256_set1_ps(0.5f));
+	__m256 x2 = _mm256_mul_ps(x, x);
+	__m256 num = _mm256_fmadd_ps(x2, _mm256_set1_ps(-32.44191367f), _mm256_set1_ps(33.19863968f));
+	num = _mm256_mul_ps(x, _mm256_fmadd_ps(x2, num, _mm256_set1_ps(-6.283185307f)));
+	__m256 den = _mm256_fmadd_ps(x2, _mm256_set1_ps(0.7028072946f), _mm256_set1_ps(1.296008659f));
+	den = _mm256_fmadd_ps(x2, den, _mm256_set1_ps(1.f));
+	return _mm256_div_ps(num, den);
+}
+
+TARGET_AVX2 static inline __m256 sin2piPade76_8(__m256 x) {
+	x = _mm256_sub_ps(x, _mm256_set1_ps(0.5f));
+	__m256 x2 = _mm256_mul_ps(x, x);
+	__m256 num = _mm256_fmadd_ps(x2, _mm256_set1_ps(16.0951f), _mm256_set1_ps(-44.9043f));
+	num = _mm256_fmadd_ps(x2, num, _mm256_set1_ps(35.353f));
+	num = _mm256_mul_ps(x, _mm256_fmadd_ps(x2, num, _mm256_set1_ps(-6.28319f)));
+	__m256 den = _mm256_fmadd_ps(x2, _mm256_set1_ps(0.0981408f), _mm256_set1_ps(0.430238f));
+	den = _mm256_fmadd_ps(x2, den, _mm256_set1_ps(0.953136f));
+	den = _mm256_fmadd_ps(x2, den, _mm256_set1_ps(1.f));
+	return _mm256_div_ps(num, den);
+}
+
+TARGET_AVX2 float_4 renderPartials8(float_4* phase, float_4* freq, const float_4* freqStep,
+	float_4* amp, const float_4* ampStep, const int* partials, int numPartials, float deltaTime, SineShape shape) {
+	__m256 out = _mm256_setzero_ps();
+	for (int i = 0; i < numPartials; i += 2) {
+		// Pad an odd partial count with a silent partial
+		int p[2] = {partials[i], i + 1 < numPartials ? partials[i + 1] : -1};
+
+		__m256 ph = load8(phase, p);
+		__m256 fr = load8(freq, p);
+		__m256 a = load8(amp, p);
+
+		// Advance and wrap phase
+		__m256 deltaPhase = _mm256_mul_ps(fr, _mm256_set1_ps(deltaTime));
+		deltaPhase = _mm256_min_ps(_mm256_max_ps(deltaPhase, _mm256_setzero_ps()), _mm256_set1_ps(0.35f));
+		ph = _mm256_add_ps(ph, deltaPhase);
+		ph = _mm256_sub_ps(ph, _mm256_floor_ps(ph));
+
+		__m256 v;
+		switch (shape) {
+			case SineShape::QUADRATIC: v = sin2piQuadratic8(ph); break;
+			case SineShape::PADE_7_6: v = sin2piPade76_8(ph); break;
+			default: v = sin2piPade54_8(ph); break;
+		}
+		out = _mm256_fmadd_ps(a, v, out);
+
+		store8(phase, p, ph);
+		store8(freq, p, _mm256_add_ps(fr, load8(freqStep, p)));
+		store8(amp, p, _mm256_add_ps(a, load8(ampStep, p)));
+	}
+	return float_4(_mm_add_ps(_mm256_castps256_ps128(out), _mm256_extractf128_ps(out, 1)));
+}
+
+
+// 16 wide: four partials of four voices per register
+
+TARGET_AVX512 static inline __m512 load16(const float_4* a, const int* p) {
+	__m512 v = _mm512_castps128_ps512(a[p[0]].v);
+	v = _mm512_insertf32x4(v, p[1] >= 0 ? a[p[1]].v : _mm_setzero_ps(), 1);
+	v = _mm512_insertf32x4(v, p[2] >= 0 ? a[p[2]].v : _mm_setzero_ps(), 2);
+	v = _mm512_insertf32x4(v, p[3] >= 0 ? a[p[3]].v : _mm_setzero_ps(), 3);
+	return v;
+}
+
+TARGET_AVX512 static inline void store16(float_4* a, const int* p, __m512 v) {
+	a[p[0]].v = _mm512_castps512_ps128(v);
+	if (p[1] >= 0)
+		a[p[1]].v = _mm512_extractf32x4_ps(v, 1);
+	if (p[2] >= 0)
+		a[p[2]].v = _mm512_extractf32x4_ps(v, 2);
+	if (p[3] >= 0)
+		a[p[3]].v = _mm512_extractf32x4_ps(v, 3);
+}
+
+TARGET_AVX512 static inline __m512 sin2piQuadratic16(__m512 x) {
+	__mmask16 half = _mm512_cmp_ps_mask(x, _mm512_set1_ps(0.5f), _CMP_LT_OQ);
+	__m512 y = _mm512_sub_ps(x, _mm512_mask_blend_ps(half, _mm512_set1_ps(0.75f), _mm512_set1_ps(0.25f)));
+	__m512 v = _mm512_fnmadd_ps(_mm512_mul_ps(_mm512_set1_ps(16.f), y), y, _mm512_set1_ps(1.f));
+	return _mm512_mask_blend_ps(half, _mm512_sub_ps(_mm512_setzero_ps(), v), v);
+}
+
+TARGET_AVX512 static inline __m512 sin2piPade54_16(__m512 x) {
+	x = _mm512_sub_ps(x, _mm512_set1_ps(0.5f));
+	__m512 x2 = _mm512_mul_ps(x, x);
+	__m512 num = _mm512_fmadd_ps(x2, _mm512_set1_ps(-32.44191367f), _mm512_set1_ps(33.19863968f));
+	num = _mm512_mul_ps(x, _mm512_fmadd_ps(x2, num, _mm512_set1_ps(-6.283185307f)));
+	__m512 den = _mm512_fmadd_ps(x2, _mm512_set1_ps(0.7028072946f), _mm512_set1_ps(1.296008659f));
+	den = _mm512_fmadd_ps(x2, den, _mm512_set1_ps(1.f));
+	return _mm512_div_ps(num, den);
+}
+
+TARGET_AVX512 static inline __m512 sin2piPade76_16(__m512 x) {
+	x = _mm512_sub_ps(x, _mm512_set1_ps(0.5f));
+	__m512 x2 = _mm512_mul_ps(x, x);
+	__m512 num = _mm512_fmadd_ps(x2, _mm512_set1_ps(16.0951f), _mm512_set1_ps(-44.9043f));
+	num = _mm512_fmadd_ps(x2, num, _mm512_set1_ps(35.353f));
+	num = _mm512_mul_ps(x, _mm512_fmadd_ps(x2, num, _mm512_set1_ps(-6.28319f)));
+	__m512 den = _mm512_fmadd_ps(x2, _mm512_set1_ps(0.0981408f), _mm512_set1_ps(0.430238f));
+	den = _mm512_fmadd_ps(x2, den, _mm512_set1_ps(0.953136f));
+	den = _mm512_fmadd_ps(x2, den, _mm512_set1_ps(1.f));
+	return _mm512_div_ps(num, den);
+}
+
+TARGET_AVX512 float_4 renderPartials16(float_4* phase, float_4* freq, const float_4* freqStep,
+	float_4* amp, const float_4* ampStep, const int* partials, int numPartials, float deltaTime, SineShape shape) {
+	__m512 out = _mm512_setzero_ps();
+	for (int i = 0; i < numPartials; i += 4) {
+		int p[4];
+		for (int j = 0; j < 4; j++)
+			p[j] = i + j < numPartials ? partials[i + j] : -1;
+
+		__m512 ph = load16(phase, p);
+		__m512 fr = load16(freq, p);
+		__m512 a = load16(amp, p);
+
+		__m512 deltaPhase = _mm512_mul_ps(fr, _mm512_set1_ps(deltaTime));
+		deltaPhase = _mm512_min_ps(_mm512_max_ps(deltaPhase, _mm512_setzero_ps()), _mm512_set1_ps(0.35f));
+		ph = _mm512_add_ps(ph, deltaPhase);
+		ph = _mm512_sub_ps(ph, _mm512_roundscale_ps(ph, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC));
+
+		__m512 v;
+		switch (shape) {
+			case SineShape::QUADRATIC: v = sin2piQuadratic16(ph); break;
+			case SineShape::PADE_7_6: v = sin2piPade76_16(ph); break;
+			default: v = sin2piPade54_16(ph); break;
+		}
+		out = _mm512_fmadd_ps(a, v, out);
+
+		store16(phase, p, ph);
+		store16(freq, p, _mm512_add_ps(fr, load16(freqStep, p)));
+		store16(amp, p, _mm512_add_ps(a, load16(ampStep, p)));
+	}
+	__m128 sum = _mm_add_ps(_mm512_castps512_ps128(out), _mm512_extractf32x4_ps(out, 1));
+	sum = _mm_add_ps(sum, _mm_add_ps(_mm512_extractf32x4_ps(out, 2), _mm512_extractf32x4_ps(out, 3)));
+	return float_4(sum);
+}
+
+// Time a kernel on a full bank of partials
+template <typename F>
+static double timeKernel(F kernel) {
+	const int n = 64;
+	float_4 phase[n], freq[n], freqStep[n], amp[n], ampStep[n];
+	int partials[n];
+	for (int p = 0; p < n; p++) {
+		phase[p] = 0.f;
+		freq[p] = 100.f * (p + 1);
+		freqStep[p] = 0.f;
+		amp[p] = 1.f / (p + 1);
+		ampStep[p] = 0.f;
+		partials[p] = p;
+	}
+	float_4 out = 0.f;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < 256; i++) {
+		out += kernel(phase, freq, freqStep, amp, ampStep, partials, n, 1.f / 48000.f, SineShape::PADE_5_4);
+	}
+	double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	// Keep the result alive
+	return out[0] == INFINITY ? INFINITY : time;
+}
+
+int getPartialKernelWidth() {
+	static int width = []() {
+		__builtin_cpu_init();
+		bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+		bool avx512 = __builtin_cpu_supports("avx512f");
+		if (!avx512)
+			return avx2 ? 8 : 4;
+		if (!avx2)
+			return 16;
+		// 512 bit registers may lower the clock and need more shuffling to load, so measure which is faster
+		double time8 = std::min(timeKernel(renderPartials8), timeKernel(renderPartials8));
+		double time16 = std::min(timeKernel(renderPartials16), timeKernel(renderPartials16));
+		return time16 < time8 ? 16 : 8;
+	}();
+	return width;
+}
+
+#else
+
+// Only the float_4 path is available on this architecture
+int getPartialKernelWidth() {
+	return 4;
+}
+
+float_4 renderPartials8(float_4* phase, float_4* freq, const float_4* freqStep,
+	float_4* amp, const float_4* ampStep, const int* partials, int numPartials, float deltaTime, SineShape shape) {
+	return 0.f;
+}
+
+float_4 renderPartials16(float_4* phase, float_4* freq, const float_4* freqStep,
+	float_4* amp, const float_4* ampStep, const int* partials, int numPartials, float deltaTime, SineShape shape) {
+	return 0.f;
+}
+
+#endif
@@ -0,0 +1,21 @@
+#pragma once
+#include <rack.hpp>
+
+// Sine approximations, from cheapest to most accurate
+enum class SineShape : int {
+	QUADRATIC = 0,
+	PADE_5_4 = 1,
+	PADE_7_6 = 2
+};
+
+// Partial kernel width for this CPU: 16 (AVX-512), 8 (AVX2 and FMA) or 4 (float_4 fallback).
+// When both wide kernels are supported, the faster one is measured on first use.
+int getPartialKernelWidth();
+
+// Renders the partials of a bank of four voices without sync, packing two (8 wide) or four (16 wide)
+// partials into one register. Advances phases and the frequency and amplitude ramps like the float_4
+// path and returns the sum over the given partials for each voice.
+rack::simd::float_4 renderPartials8(rack::simd::float_4* phase, rack::simd::float_4* freq, const rack::simd::float_4* freqStep,
+	rack::simd::float_4* amp, const rack::simd::float_4* ampStep, const int* partials, int numPartials, float deltaTime, SineShape shape);
+rack::simd::float_4 renderPartials16(rack::simd::float_4* phase, rack::simd::float_4* freq, const rack::simd::float_4* freqStep,
+	rack::simd::float_4* amp, const rack::simd::float_4* ampStep, const int* partials, int numPartials, float deltaTime, SineShape shape);
@@ -0,0 +1,205 @@
+#pragma once
+#include <rack.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Partial set of a voice as harmonics of a table period that may span several fundamental cycles
+struct WavetableSpec {
+	static const int MAX_PARTIALS = 64;
+	// Longest table period, in cycles of the fundamental
+	static const int MAX_CYCLES = 64;
+	static const int MAX_HARMONIC = 512;
+
+	int cycles = 1;
+	int numPartials = 0;
+	int harmonics[MAX_PARTIALS] = {};
+	float amps[MAX_PARTIALS] = {};
+
+	// Finds the shortest period after which all audible partials repeat, to within half a cent.
+	// Returns false for partial ratios that are inharmonic at any period that fits a table.
+	bool fromPartials(const float* relFreqs, const float* partialAmps, int n, float threshold) {
+		const float tolerance = 2.9e-4f;
+		for (int k = 1; k <= MAX_CYCLES; k++) {
+			numPartials = 0;
+			bool fits = true;
+			for (int p = 0; p < n && fits; p++) {
+				if (partialAmps[p] <= threshold)
+					continue;
+				float h = relFreqs[p] * k;
+				int harmonic = (int)roundf(h);
+				fits = harmonic >= 1 && harmonic <= MAX_HARMONIC && fabsf(h - harmonic) <= tolerance * h;
+				harmonics[numPartials] = harmonic;
+				amps[numPartials] = partialAmps[p];
+				numPartials++;
+			}
+			if (fits) {
+				cycles = k;
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+
+// Mip-mapped single period of a WavetableSpec. Level j holds the harmonics up to MAX_HARMONIC >> j
+// at 16 samples per cycle of the highest one, plus a guard sample for interpolation.
+struct Wavetable {
+	static const int NUM_LEVELS = 10;
+	static const int MIN_SIZE = 64;
+
+	int cycles = 1;
+	int sizes[NUM_LEVELS];
+	int offsets[NUM_LEVELS];
+	int totalSize = 0;
+	// Empty until allocate(), so that modules which never use a wavetable do not hold one
+	std::vector<float> data;
+
+	Wavetable() {
+		for (int j = 0; j < NUM_LEVELS; j++) {
+			sizes[j] = std::max(16 * (WavetableSpec::MAX_HARMONIC >> j), MIN_SIZE);
+			offsets[j] = totalSize;
+			totalSize += sizes[j] + 1;
+		}
+	}
+
+	void allocate() {
+		data.resize(totalSize);
+	}
+
+	static int getMaxHarmonic(int level) {
+		return WavetableSpec::MAX_HARMONIC >> level;
+	}
+
+	// Lowest level whose harmonics stay below Nyquist at the given table frequency
+	static int getLevel(float tableFreq, float sampleTime) {
+		float limit = 0.5f / std::max(tableFreq * sampleTime, 1e-9f);
+		int level = 0;
+		while (level < NUM_LEVELS - 1 && getMaxHarmonic(level) > limit)
+			level++;
+		return level;
+	}
+
+	float lookup(int level, float phase) const {
+		const float* d = &data[offsets[level]];
+		float x = phase * sizes[level];
+		int i = std::min((int)x, sizes[level] - 1);
+		float f = x - i;
+		return d[i] + f * (d[i + 1] - d[i]);
+	}
+
+	void build(const WavetableSpec& spec, const std::vector<float>& sine) {
+		int sineSize = sine.size();
+		cycles = spec.cycles;
+		for (int j = 0; j < NUM_LEVELS; j++) {
+			float* d = &data[offsets[j]];
+			int size = sizes[j];
+			int stride = sineSize / size;
+			for (int i = 0; i < size; i++) {
+				float v = 0.f;
+				for (int p = 0; p < spec.numPartials; p++) {
+					if (spec.harmonics[p] > getMaxHarmonic(j))
+						continue;
+					v += spec.amps[p] * sine[(spec.harmonics[p] * i * stride) & (sineSize - 1)];
+				}
+				d[i] = v;
+			}
+			d[size] = d[0];
+		}
+	}
+};
+
+
+// Builds wavetables on a worker thread. The audio thread owns the front table and may read
+// the back table while crossfading, so it only requests a build when it is done with the back table.
+// The tables and the thread only exist once start() was called from outside the audio thread.
+struct WavetableBuilder {
+	enum State {
+		IDLE,
+		REQUESTED,
+		READY
+	};
+
+	Wavetable tables[2];
+	int front = 0;
+	bool hasTable = false;
+
+	WavetableSpec pending;
+	std::atomic<int> state{IDLE};
+	std::atomic<bool> running{false};
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable cv;
+
+	~WavetableBuilder() {
+		if (!thread.joinable())
+			return;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running = false;
+		}
+		cv.notify_one();
+		thread.join();
+	}
+
+	// Called from the UI thread when wavetable mode is enabled, does nothing if already started
+	void start() {
+		if (thread.joinable())
+			return;
+		tables[0].allocate();
+		tables[1].allocate();
+		running = true;
+		thread = std::thread([this]() { run(); });
+	}
+
+	const Wavetable& getFront() const {
+		return tables[front];
+	}
+	const Wavetable& getBack() const {
+		return tables[front ^ 1];
+	}
+
+	// Called from the audio thread. Returns false without waiting before start(), while a build is in flight
+	// or if the worker is checking for work, in which case the caller tries again on its next control block.
+	bool request(const WavetableSpec& spec) {
+		if (!running || state != IDLE)
+			return false;
+		std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+		if (!lock.owns_lock())
+			return false;
+		pending = spec;
+		state = REQUESTED;
+		lock.unlock();
+		cv.notify_one();
+		return true;
+	}
+
+	// Called from the audio thread, swaps in a finished table and returns true
+	bool poll() {
+		if (state != READY)
+			return false;
+		front ^= 1;
+		hasTable = true;
+		state = IDLE;
+		return true;
+	}
+
+	void run() {
+		std::vector<float> sine(Wavetable().sizes[0]);
+		for (size_t i = 0; i < sine.size(); i++) {
+			sine[i] = std::sin(2 * M_PI * i / sine.size());
+		}
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				cv.wait(lock, [this]() { return state == REQUESTED || !running; });
+				if (!running)
+					return;
+			}
+			tables[front ^ 1].build(pending, sine);
+			state = READY;
+		}
+	}
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include <cmath>
+#include "hsluv.h"
+
+// Full saturation HSLuv colors at the lightness levels used for key coloring, tabulated over hue once
+// so that coloring keys never runs the LUV/XYZ conversion on the audio or UI thread.
+struct HsluvPalette {
+	// 0.35 degrees per step; interpolated lookups stay within two levels of the 7 bit Exquis colors
+	static const int HUE_STEPS = 1024;
+
+	enum Lightness {
+		LIGHTNESS_DARK = 0,
+		LIGHTNESS_BRIGHT,
+		NUM_LIGHTNESS
+	};
+
+	float rgb[NUM_LIGHTNESS][HUE_STEPS][3];
+
+	HsluvPalette(){
+		const double lightness[NUM_LIGHTNESS] = {30.0, 70.0};
+		for (int l = 0; l < NUM_LIGHTNESS; l++){
+			for (int i = 0; i < HUE_STEPS; i++){
+				double r, g, b;
+				hsluv2rgb(360.0 * i / HUE_STEPS, 100.0, lightness[l], &r, &g, &b);
+				rgb[l][i][0] = r;
+				rgb[l][i][1] = g;
+				rgb[l][i][2] = b;
+			}
+		}
+	}
+
+	// Interpolates the r, g, b components in [0, 1] for a hue in degrees
+	void get(float hue, Lightness lightness, float* r, float* g, float* b) const {
+		float x = hue * (HUE_STEPS / 360.f);
+		float i0 = std::floor(x);
+		float f = x - i0;
+		int i = (int)i0 % HUE_STEPS;
+		if (i < 0){
+			i += HUE_STEPS;
+		}
+		const float* c0 = rgb[lightness][i];
+		const float* c1 = rgb[lightness][(i + 1) % HUE_STEPS];
+		*r = c0[0] + f * (c1[0] - c0[0]);
+		*g = c0[1] + f * (c1[1] - c0[1]);
+		*b = c0[2] + f * (c1[2] - c0[2]);
+	}
+};
+
+inline const HsluvPalette& getHsluvPalette(){
+	static HsluvPalette palette;
+	return palette;
+}
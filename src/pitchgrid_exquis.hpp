@@ -4,7 +4,7 @@
 #include "exquis.hpp"
 #include "continuedFraction.hpp"
 
-#include "hsluv.h"
+#include "hsluv_palette.hpp"
 
 
 struct ExquisScaleMapper {
@@ -120,6 +120,10 @@ struct PitchGridExquis: Exquis {
 
 	bool needsRetune = false;
 
+	// Knob retuning received since the last retune clock tick, applied in one go
+	float pendingRetuneAmount = 0.f;
+	dsp::ClockDivider retuneClock;
+
 	std::string lastNotePlayedLabel = "";
 	std::string lastNotePlayedNameLabel = "";
 
@@ -136,6 +140,8 @@ struct PitchGridExquis: Exquis {
 		scaleMapper = ExquisScaleMapper();
 		scaleMapper.scale.mode=5;
 		showAllOctavesLayer();
+		retuneClock.setDivision(256); // ~5ms at 48kHz
+		getHsluvPalette(); // build the palette now rather than on first use in the audio thread
 	}
 
 	void initialize(){
@@ -149,15 +155,73 @@ struct PitchGridExquis: Exquis {
 		resetOctaveDownButton();
 	}	
 
-	void showAllOctavesLayer(){
-		if (!tuning){
+	// The all octaves layer is computed in cached stages, each recomputed only when its inputs change:
+	// scale coordinates <- layout, degrees <- scale, colors <- tuning and color scheme.
+	// Offset changes leave the colors alone since they only depend on the tuning without offset.
+	bool layerCoordsDirty = true;
+	bool layerDegreesDirty = true;
+	bool layerColorsDirty = true;
+	ExquisVector layerBase, layerInterval1, layerInterval2;
+	ScaleVector layerScaleSystem;
+	int layerMode = -1;
+	int layerN = -1;
+	float layerVoltage1 = NAN;
+	float layerVoltage2 = NAN;
+	ColorScheme layerColorScheme = NUM_COLORSCHEMES;
+	Color layerColors[61];
+	float layerBrightness[61];
+
+	void updateKeyLayerCoords(){
+		if (!(scaleMapper.exquis_base == layerBase && scaleMapper.exquis_interval1 == layerInterval1 && scaleMapper.exquis_interval2 == layerInterval2)){
+			layerBase = scaleMapper.exquis_base;
+			layerInterval1 = scaleMapper.exquis_interval1;
+			layerInterval2 = scaleMapper.exquis_interval2;
+			layerCoordsDirty = true;
+		}
+		if (!layerCoordsDirty){
 			return;
 		}
 		for (ExquisNote& note : notes){
-
 			note.scaleCoord = scaleMapper.exquis2scale(note.coord - scaleMapper.exquis_base);
-			note.scaleSeqNr = scaleMapper.scale.coordToScaleNoteSeqNr(note.scaleCoord);
-			float octave_fr = tuning ? tuning->vecToVoltageNoOffset(scaleMapper.scale.scale_system) - tuning->vecToVoltageNoOffset(ZERO_VECTOR) : 1.f;
+		}
+		layerCoordsDirty = false;
+		layerDegreesDirty = true;
+	}
+
+	void updateKeyLayerDegrees(){
+		RegularScale& scale = scaleMapper.scale;
+		if (!(scale.scale_system == layerScaleSystem && scale.mode == layerMode && scale.n == layerN)){
+			layerScaleSystem = scale.scale_system;
+			layerMode = scale.mode;
+			layerN = scale.n;
+			layerDegreesDirty = true;
+		}
+		if (!layerDegreesDirty){
+			return;
+		}
+		for (ExquisNote& note : notes){
+			note.scaleSeqNr = scale.coordToScaleNoteSeqNr(note.scaleCoord);
+		}
+		layerDegreesDirty = false;
+		layerColorsDirty = true;
+	}
+
+	// Only called through showAllOctavesLayer, once the tuning is set
+	void updateKeyLayerColors(){
+		// the hue is linear in the scale coordinate, so the two basis voltages determine all of it
+		float voltage1 = tuning->vecToVoltageNoOffset({1,0});
+		float voltage2 = tuning->vecToVoltageNoOffset({0,1});
+		if (!(voltage1 == layerVoltage1 && voltage2 == layerVoltage2 && colorScheme == layerColorScheme)){
+			layerVoltage1 = voltage1;
+			layerVoltage2 = voltage2;
+			layerColorScheme = colorScheme;
+			layerColorsDirty = true;
+		}
+		if (!layerColorsDirty){
+			return;
+		}
+		float octave_fr = tuning->vecToVoltageNoOffset(scaleMapper.scale.scale_system) - tuning->vecToVoltageNoOffset(ZERO_VECTOR);
+		for (ExquisNote& note : notes){
 			switch(colorScheme){
 				case COLORSCHEME_SCALE_MONOCHROME:
 					if (note.scaleSeqNr != -1){
@@ -178,19 +242,13 @@ struct PitchGridExquis: Exquis {
 					if (note.scaleSeqNr != -1){
 
 						note.brightness = 1.f;
-						double r, g, b;
-						float h;
-						if (tuning){
-							h = (tuning->vecToVoltageNoOffset(note.scaleCoord)) / octave_fr;
-						}else{
-							h = (float)(note.scaleCoord * scaleMapper.scale.scale_system) / (scaleMapper.scale.scale_system * scaleMapper.scale.scale_system);
-						}
+						float h = (tuning->vecToVoltageNoOffset(note.scaleCoord)) / octave_fr;
 						h = 360.f * posfmod(h+.106f, 1.f);
 
-						hsluv2rgb(
-							(double)h,
-							100.f,
-							note.scaleCoord == ZERO_VECTOR ? 70.f: 30.f,
+						float r, g, b;
+						getHsluvPalette().get(
+							h,
+							note.scaleCoord == ZERO_VECTOR ? HsluvPalette::LIGHTNESS_BRIGHT : HsluvPalette::LIGHTNESS_DARK,
 							&r, &g, &b
 						);
 						note.color = Color(127*r, 127*g, 127*b);
@@ -204,6 +262,24 @@ struct PitchGridExquis: Exquis {
 					break;
 			}
 		}
+		for (int i = 0; i < 61; i++){
+			layerColors[i] = notes[i].color;
+			layerBrightness[i] = notes[i].brightness;
+		}
+		layerColorsDirty = false;
+	}
+
+	void showAllOctavesLayer(){
+		if (!tuning){
+			return;
+		}
+		updateKeyLayerCoords();
+		updateKeyLayerDegrees();
+		updateKeyLayerColors();
+		for (int i = 0; i < 61; i++){
+			notes[i].color = layerColors[i];
+			notes[i].brightness = layerBrightness[i];
+		}
 		needsNoteDisplayUpdate = true;
 	}	
 
@@ -412,6 +488,24 @@ struct PitchGridExquis: Exquis {
 
 	}
 
+	// A fast knob spin sends dozens of CCs per block, so their amounts are summed and applied with a
+	// single retune and key display update. All three retune paths compose additively in cents.
+	void queueRetune(float amount){
+		pendingRetuneAmount += amount;
+	}
+	void flushRetune(){
+		if (pendingRetuneAmount != 0.f){
+			float amount = pendingRetuneAmount;
+			pendingRetuneAmount = 0.f;
+			retuneIntervalByAmount(amount);
+		}
+	}
+	void processPendingUpdates() override {
+		if (retuneClock.process()){
+			flushRetune();
+		}
+	}
+
 	void justifyTuning(){
 		// TODO: check crash
 		if (tuningModeOn && tuningModeRetuneInterval != ZERO_VECTOR){
@@ -462,6 +556,11 @@ struct PitchGridExquis: Exquis {
 
 
 	void processMidiMessage(midi::Message msg) override {
+		// apply queued knob retuning before anything that may change what it retunes
+		bool retuneKnob = msg.bytes.size() == 3 && msg.bytes[0] == 0xbf && (msg.bytes[1] == 0x6E || msg.bytes[1] == 0x6F);
+		if (!retuneKnob){
+			flushRetune();
+		}
 		// react to cc messages on channel 16 (0xbf)
 		if (msg.bytes.size() == 3 && msg.bytes[0] == 0xbf) {
 			uint8_t controllerId = msg.bytes[1];
@@ -565,7 +664,7 @@ struct PitchGridExquis: Exquis {
 							showSingleOctaveLayer();
 							needsRetune = true;
 						}else if (tuningModeOn){
-							retuneIntervalByAmount(-10.0*value/127);
+							queueRetune(-10.0*value/127);
 						}
 					}else{
 						// increment
@@ -575,7 +674,7 @@ struct PitchGridExquis: Exquis {
 							showSingleOctaveLayer();
 							needsRetune = true;
 						}else if (tuningModeOn){
-							retuneIntervalByAmount(10.0*value/127);
+							queueRetune(10.0*value/127);
 						}
 					}
 					break;
@@ -587,7 +686,7 @@ struct PitchGridExquis: Exquis {
 							showSingleOctaveLayer();
 							needsRetune = true;
 						}else if (tuningModeOn){
-							retuneIntervalByAmount(-0.1*value/127);
+							queueRetune(-0.1*value/127);
 						}
 					}else{
 						if (arrangeModeOn){
@@ -596,7 +695,7 @@ struct PitchGridExquis: Exquis {
 							showSingleOctaveLayer();
 							needsRetune = true;
 						}else if (tuningModeOn){
-							retuneIntervalByAmount(0.1*value/127);
+							queueRetune(0.1*value/127);
 						}
 					}
 					break;
@@ -9,6 +9,7 @@ void init(Plugin* p) {
 	p->addModel(modelMicroVOctMapper);
 	p->addModel(modelMicroExquis);
 	p->addModel(modelMicroHammond);
+	p->addModel(modelMicroHammondCV);
 
 }
 
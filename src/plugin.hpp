@@ -8,6 +8,7 @@ extern Plugin* pluginInstance;
 
 extern Model* modelMicroExquis;
 extern Model* modelMicroHammond;
+extern Model* modelMicroHammondCV;
 extern Model* modelMicroVOctMapper;
 
 struct DigitalDisplay : Widget {
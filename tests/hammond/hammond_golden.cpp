@@ -0,0 +1,221 @@
+// Golden-output regression and timing harness for VCOMH (MicroHammond).
+//
+// Renders fixed pitch, FM and sync scenarios for every TuningPresets value at 1 to 16 channels against the
+// Rack shim, compares each render with the stored reference buffers and reports ns/sample per configuration.
+// Voices are independent, so one 16 channel reference per scenario and preset covers all channel counts:
+// channel c of every render must match channel c of the reference. The first control block is not compared.
+//
+//   hammond_golden           check against golden/ and report timing, exits 1 on a mismatch
+//   hammond_golden --write   render the references into golden/
+
+#include "MicroHammond.cpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+static const float SAMPLE_RATE = 48000.f;
+static const int CHECK_SAMPLES = 1024;
+// Rendered after the checked samples, for timing only
+static const int TIMING_SAMPLES = 4096;
+static const int NUM_PRESETS = 10;
+// Partial amplitudes ramp in from silence over the first 16 sample control block, the baseline started at
+// full level
+static const int WARMUP_SAMPLES = 16;
+// Worst-case absolute error in volts. Covers the FMA and wide kernels the host CPU may select.
+static const float TOLERANCE = 2e-3f;
+
+enum Scenario {
+	SCENARIO_PITCH,
+	SCENARIO_FM,
+	SCENARIO_SYNC,
+	NUM_SCENARIOS
+};
+static const char* SCENARIO_NAMES[NUM_SCENARIOS] = {"pitch", "fm", "sync"};
+
+struct Render {
+	std::vector<float> out;
+	double nsPerSample = 0.;
+};
+
+static float channelPitch(int c) {
+	// Spread over about three octaves, off the 12-TET grid
+	return -1.5f + 0.29f * c;
+}
+
+static void setInputs(VCOMH& m, Scenario scenario, int channels, int64_t frame) {
+	double t = frame / (double) SAMPLE_RATE;
+	for (int c = 0; c < channels; c++) {
+		m.inputs[VCOMH::PITCH_INPUT].setVoltage(channelPitch(c), c);
+		if (scenario == SCENARIO_FM) {
+			// Audio-rate FM, a different rate per voice
+			double fmFreq = 110. * (1. + 0.13 * c);
+			m.inputs[VCOMH::FM_INPUT].setVoltage(std::sin(2 * M_PI * fmFreq * t), c);
+		}
+		if (scenario == SCENARIO_SYNC) {
+			// Rising saw below the voice pitch, crossing zero once per cycle
+			double syncFreq = 70. * (1. + 0.07 * c);
+			double phase = syncFreq * t;
+			m.inputs[VCOMH::SYNC_INPUT].setVoltage(2.f * (float) (phase - std::floor(phase)) - 1.f, c);
+		}
+	}
+}
+
+// The baseline rendered the quadratic sine with anti-aliased sync, which is Standard with the sine of Eco.
+// Older sources have a single sine shape.
+template <typename T>
+static auto setBaselineSineShape(T& m, int) -> decltype(m.qualitySineShapes[0], void()) {
+	using Shape = typename std::remove_reference<decltype(m.qualitySineShapes[0])>::type;
+	m.qualitySineShapes[(int) T::Quality::QUALITY_STANDARD] = Shape::QUADRATIC;
+}
+
+template <typename T>
+static void setBaselineSineShape(T& m, long) {}
+
+// The baseline applied FM per sample, the default tier applies it per control block. Older sources have no
+// option and always run at audio rate.
+template <typename T>
+static auto setAudioRateFm(T& m, int) -> decltype(m.audioRateFm = true, void()) {
+	m.audioRateFm = true;
+}
+
+template <typename T>
+static void setAudioRateFm(T& m, long) {}
+
+static Render render(int preset, Scenario scenario, int channels) {
+	VCOMH m;
+	m.setTuningPreset(preset);
+	setBaselineSineShape(m, 0);
+	m.inputs[VCOMH::PITCH_INPUT].setChannels(channels);
+	m.outputs[VCOMH::SIN_OUTPUT].setChannels(1);
+	if (scenario == SCENARIO_FM) {
+		m.inputs[VCOMH::FM_INPUT].setChannels(channels);
+		m.params[VCOMH::FM_PARAM].setValue(0.3f);
+		setAudioRateFm(m, 0);
+	}
+	if (scenario == SCENARIO_SYNC) {
+		m.inputs[VCOMH::SYNC_INPUT].setChannels(channels);
+	}
+
+	Module::ProcessArgs args;
+	args.sampleRate = SAMPLE_RATE;
+	args.sampleTime = 1.f / SAMPLE_RATE;
+
+	Render r;
+	r.out.resize(CHECK_SAMPLES * channels);
+	auto start = std::chrono::steady_clock::now();
+	for (int64_t i = 0; i < CHECK_SAMPLES + TIMING_SAMPLES; i++) {
+		args.frame = i;
+		setInputs(m, scenario, channels, i);
+		m.process(args);
+		if (i < CHECK_SAMPLES) {
+			for (int c = 0; c < channels; c++)
+				r.out[i * channels + c] = m.outputs[VCOMH::SIN_OUTPUT].getVoltage(c);
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	r.nsPerSample = seconds * 1e9 / (CHECK_SAMPLES + TIMING_SAMPLES);
+	return r;
+}
+
+static std::string goldenPath(const std::string& dir, Scenario scenario, int preset) {
+	return dir + "/" + SCENARIO_NAMES[scenario] + "_preset" + std::to_string(preset) + ".f32";
+}
+
+// References are little-endian float32, interleaved 16 channels per sample
+static bool readGolden(const std::string& path, std::vector<float>& data) {
+	FILE* f = fopen(path.c_str(), "rb");
+	if (!f)
+		return false;
+	data.resize(CHECK_SAMPLES * 16);
+	size_t n = fread(data.data(), sizeof(float), data.size(), f);
+	fclose(f);
+	return n == data.size();
+}
+
+static bool writeGolden(const std::string& path, const std::vector<float>& data) {
+	FILE* f = fopen(path.c_str(), "wb");
+	if (!f)
+		return false;
+	size_t n = fwrite(data.data(), sizeof(float), data.size(), f);
+	fclose(f);
+	return n == data.size();
+}
+
+int main(int argc, char** argv) {
+	bool write = false;
+	std::string dir = "golden";
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--write"))
+			write = true;
+		else
+			dir = argv[i];
+	}
+
+	if (write) {
+		for (int s = 0; s < NUM_SCENARIOS; s++) {
+			for (int preset = 0; preset < NUM_PRESETS; preset++) {
+				Render r = render(preset, (Scenario) s, 16);
+				std::string path = goldenPath(dir, (Scenario) s, preset);
+				if (!writeGolden(path, r.out)) {
+					fprintf(stderr, "cannot write %s\n", path.c_str());
+					return 1;
+				}
+			}
+		}
+		printf("wrote %d references to %s\n", NUM_SCENARIOS * NUM_PRESETS, dir.c_str());
+		return 0;
+	}
+
+	int failures = 0;
+	printf("ns/sample by channel count\n%-16s", "scenario");
+	for (int channels = 1; channels <= 16; channels++)
+		printf("%6d", channels);
+	printf("\n");
+	for (int s = 0; s < NUM_SCENARIOS; s++) {
+		for (int preset = 0; preset < NUM_PRESETS; preset++) {
+			std::vector<float> golden;
+			std::string path = goldenPath(dir, (Scenario) s, preset);
+			if (!readGolden(path, golden)) {
+				fprintf(stderr, "missing reference %s\n", path.c_str());
+				return 1;
+			}
+			char label[32];
+			snprintf(label, sizeof(label), "%s preset %d", SCENARIO_NAMES[s], preset);
+			printf("%-16s", label);
+			std::string errors;
+			for (int channels = 1; channels <= 16; channels++) {
+				Render r = render(preset, (Scenario) s, channels);
+				printf("%6.0f", r.nsPerSample);
+				float maxError = 0.f;
+				int worstSample = 0;
+				for (int i = WARMUP_SAMPLES; i < CHECK_SAMPLES; i++) {
+					for (int c = 0; c < channels; c++) {
+						float error = std::fabs(r.out[i * channels + c] - golden[i * 16 + c]);
+						// NAN compares false, so count it explicitly
+						if (!(error <= maxError)) {
+							maxError = std::isnan(error) ? INFINITY : error;
+							worstSample = i;
+						}
+					}
+				}
+				if (!(maxError <= TOLERANCE)) {
+					char msg[96];
+					snprintf(msg, sizeof(msg), "  FAIL %d channels: max error %g V at sample %d\n", channels, maxError, worstSample);
+					errors += msg;
+					failures++;
+				}
+			}
+			printf("\n%s", errors.c_str());
+		}
+	}
+	if (failures) {
+		printf("%d configurations differ from the references by more than %g V\n", failures, TOLERANCE);
+		return 1;
+	}
+	printf("all %d configurations match the references within %g V\n", NUM_SCENARIOS * NUM_PRESETS * 16, TOLERANCE);
+	return 0;
+}
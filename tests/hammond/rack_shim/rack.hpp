@@ -0,0 +1,330 @@
+// Minimal stand-in for the parts of the VCV Rack SDK that MicroHammond.cpp uses, so the module can be
+// rendered without Rack. Everything that affects the audio output (params, ports, simd, minBLEP) behaves
+// like Rack; UI, JSON and MIDI are no-ops.
+#pragma once
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include <sstream>
+#include <map>
+#include <set>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <pmmintrin.h>
+#include <immintrin.h>
+
+typedef struct json_t json_t;
+json_t* json_object(); json_t* json_array(); json_t* json_integer(long long); json_t* json_real(double);
+json_t* json_boolean(bool); json_t* json_true(); json_t* json_false(); json_t* json_string(const char*);
+int json_object_set_new(json_t*, const char*, json_t*); json_t* json_object_get(const json_t*, const char*);
+int json_array_append_new(json_t*, json_t*); json_t* json_array_get(const json_t*, size_t); size_t json_array_size(const json_t*);
+long long json_integer_value(const json_t*); double json_number_value(const json_t*); double json_real_value(const json_t*);
+bool json_is_array(const json_t*); bool json_is_integer(const json_t*); bool json_is_number(const json_t*); bool json_is_object(const json_t*);
+bool json_is_true(const json_t*); bool json_boolean_value(const json_t*); bool json_is_boolean(const json_t*); const char* json_string_value(const json_t*);
+
+struct NVGcolor { float r, g, b, a; };
+struct NVGcontext;
+NVGcolor nvgRGB(unsigned char, unsigned char, unsigned char);
+NVGcolor nvgRGBA(unsigned char, unsigned char, unsigned char, unsigned char);
+NVGcolor nvgRGBf(float, float, float);
+void nvgBeginPath(NVGcontext*); void nvgClosePath(NVGcontext*); void nvgFill(NVGcontext*); void nvgStroke(NVGcontext*);
+void nvgFillColor(NVGcontext*, NVGcolor); void nvgStrokeColor(NVGcontext*, NVGcolor); void nvgFontFaceId(NVGcontext*, int); void nvgFontSize(NVGcontext*, float);
+void nvgLineTo(NVGcontext*, float, float); void nvgMoveTo(NVGcontext*, float, float); void nvgRect(NVGcontext*, float, float, float, float);
+void nvgRoundedRect(NVGcontext*, float, float, float, float, float); float nvgText(NVGcontext*, float, float, const char*, const char*);
+void nvgTextAlign(NVGcontext*, int); void nvgTextLetterSpacing(NVGcontext*, float);
+enum { NVG_ALIGN_LEFT = 1, NVG_ALIGN_CENTER = 2, NVG_ALIGN_RIGHT = 4, NVG_ALIGN_MIDDLE = 16 };
+
+#define INFO(...) ((void)0)
+#define WARN(...) ((void)0)
+#define DEBUG(...) ((void)0)
+#define ENUMS(name, count) name, name##_LAST = name + (count) - 1
+
+namespace rack {
+namespace string { std::string f(const char* fmt, ...); }
+namespace math {
+	struct Vec { float x = 0, y = 0; Vec() {} Vec(float x, float y) : x(x), y(y) {} Vec minus(Vec b) const { return Vec(x - b.x, y - b.y); }
+		Vec plus(Vec b) const { return Vec(x + b.x, y + b.y); } Vec mult(float s) const { return Vec(x * s, y * s); } };
+	struct Rect { Vec pos, size; };
+	inline float clamp(float x, float a = 0.f, float b = 1.f) { return std::fmax(std::fmin(x, b), a); }
+	inline int clamp(int x, int a, int b) { return std::max(std::min(x, b), a); }
+	inline float crossfade(float a, float b, float p) { return a + (b - a) * p; }
+	inline bool isNear(float a, float b, float eps = 1e-6f) { return std::fabs(a - b) <= eps; }
+	inline int log2(int n) { int i = 0; while (n >>= 1) i++; return i; }
+	inline bool isPow2(int n) { return n > 0 && (n & (n - 1)) == 0; }
+	inline float rescale(float x, float a, float b, float c, float d) { return c + (x - a) / (b - a) * (d - c); }
+	inline int eucMod(int a, int b) { int m = a % b; return m < 0 ? m + b : m; }
+	inline int eucDiv(int a, int b) { int d = a / b; if (d * b != a && (a < 0) != (b < 0)) d--; return d; }
+	inline float eucMod(float a, float b) { float m = std::fmod(a, b); return m < 0 ? m + b : m; }
+}
+using namespace math;
+inline Vec mm2px(Vec mm) { return Vec(mm.x * 75.f / 25.4f, mm.y * 75.f / 25.4f); }
+static const float RACK_GRID_WIDTH = 15; static const float RACK_GRID_HEIGHT = 380;
+
+namespace simd {
+template <typename T, int N> struct Vector;
+template <> struct Vector<int32_t, 4>;
+template <> struct Vector<float, 4> {
+	using type = float; constexpr static int size = 4;
+	union { __m128 v; float s[4]; };
+	Vector() = default;
+	Vector(__m128 v) : v(v) {}
+	Vector(float x) { v = _mm_set1_ps(x); }
+	Vector(float a, float b, float c, float d) { v = _mm_setr_ps(a, b, c, d); }
+	static Vector zero() { return Vector(_mm_setzero_ps()); }
+	static Vector mask() { return Vector(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_setzero_si128(), _mm_setzero_si128()))); }
+	static Vector load(const float* x) { return Vector(_mm_loadu_ps(x)); }
+	void store(float* x) { _mm_storeu_ps(x, v); }
+	float& operator[](int i) { return s[i]; }
+	const float& operator[](int i) const { return s[i]; }
+	Vector(Vector<int32_t, 4> a);
+	static Vector cast(Vector<int32_t, 4> a);
+};
+template <> struct Vector<int32_t, 4> {
+	using type = int32_t; constexpr static int size = 4;
+	union { __m128i v; int32_t s[4]; };
+	Vector() = default;
+	Vector(__m128i v) : v(v) {}
+	Vector(int32_t x) { v = _mm_set1_epi32(x); }
+	Vector(int32_t a, int32_t b, int32_t c, int32_t d) { v = _mm_setr_epi32(a, b, c, d); }
+	static Vector zero() { return Vector(_mm_setzero_si128()); }
+	static Vector load(const int32_t* x) { return Vector(_mm_loadu_si128((const __m128i*) x)); }
+	void store(int32_t* x) { _mm_storeu_si128((__m128i*) x, v); }
+	int32_t& operator[](int i) { return s[i]; }
+	const int32_t& operator[](int i) const { return s[i]; }
+	Vector(Vector<float, 4> a) { v = _mm_cvttps_epi32(a.v); }
+	static Vector cast(Vector<float, 4> a) { return Vector(_mm_castps_si128(a.v)); }
+};
+inline Vector<float, 4>::Vector(Vector<int32_t, 4> a) { v = _mm_cvtepi32_ps(a.v); }
+inline Vector<float, 4> Vector<float, 4>::cast(Vector<int32_t, 4> a) { return Vector(_mm_castsi128_ps(a.v)); }
+typedef Vector<float, 4> float_4; typedef Vector<int32_t, 4> int32_4;
+#define F4OP(op, fn) inline float_4 operator op(float_4 a, float_4 b) { return float_4(fn(a.v, b.v)); } \
+	inline float_4& operator op##=(float_4& a, float_4 b) { a = a op b; return a; }
+F4OP(+, _mm_add_ps) F4OP(-, _mm_sub_ps) F4OP(*, _mm_mul_ps) F4OP(/, _mm_div_ps) F4OP(&, _mm_and_ps) F4OP(|, _mm_or_ps) F4OP(^, _mm_xor_ps)
+#define F4CMP(op, fn) inline float_4 operator op(float_4 a, float_4 b) { return float_4(fn(a.v, b.v)); }
+F4CMP(==, _mm_cmpeq_ps) F4CMP(!=, _mm_cmpneq_ps) F4CMP(<, _mm_cmplt_ps) F4CMP(<=, _mm_cmple_ps) F4CMP(>, _mm_cmpgt_ps) F4CMP(>=, _mm_cmpge_ps)
+inline float_4 operator-(float_4 a) { return 0.f - a; }
+inline float_4 operator~(float_4 a) { return a ^ float_4::mask(); }
+#define I4OP(op, fn) inline int32_4 operator op(int32_4 a, int32_4 b) { return int32_4(fn(a.v, b.v)); } \
+	inline int32_4& operator op##=(int32_4& a, int32_4 b) { a = a op b; return a; }
+I4OP(+, _mm_add_epi32) I4OP(-, _mm_sub_epi32) I4OP(&, _mm_and_si128) I4OP(|, _mm_or_si128) I4OP(^, _mm_xor_si128)
+inline int32_4 operator*(int32_4 a, int32_4 b) { return int32_4(_mm_mullo_epi32(a.v, b.v)); }
+inline int32_4& operator*=(int32_4& a, int32_4 b) { a = a * b; return a; }
+inline int32_4 operator==(int32_4 a, int32_4 b) { return int32_4(_mm_cmpeq_epi32(a.v, b.v)); }
+inline int32_4 operator<(int32_4 a, int32_4 b) { return int32_4(_mm_cmplt_epi32(a.v, b.v)); }
+inline int32_4 operator>(int32_4 a, int32_4 b) { return int32_4(_mm_cmpgt_epi32(a.v, b.v)); }
+inline int32_4 operator-(int32_4 a) { return 0 - a; }
+inline int32_4 operator<<(int32_4 a, int b) { return int32_4(_mm_slli_epi32(a.v, b)); }
+inline int32_4 operator>>(int32_4 a, int b) { return int32_4(_mm_srai_epi32(a.v, b)); }
+inline float_4 ifelse(float_4 m, float_4 a, float_4 b) { return float_4(_mm_blendv_ps(b.v, a.v, m.v)); }
+inline int32_4 ifelse(int32_4 m, int32_4 a, int32_4 b) { return int32_4(_mm_blendv_epi8(b.v, a.v, m.v)); }
+inline float ifelse(bool m, float a, float b) { return m ? a : b; }
+inline int movemask(float_4 a) { return _mm_movemask_ps(a.v); }
+inline int movemask(int32_4 a) { return _mm_movemask_ps(_mm_castsi128_ps(a.v)); }
+template <typename T> T movemaskInverse(int m);
+template <> inline float_4 movemaskInverse<float_4>(int m) { int32_4 b(1, 2, 4, 8); int32_4 x = int32_4(m) & b; return float_4::cast(x == b); }
+#define F4FN(name, expr) inline float_4 name(float_4 a) { float_4 r; for (int i = 0; i < 4; i++) r.s[i] = expr(a.s[i]); return r; }
+F4FN(floor, std::floor) F4FN(ceil, std::ceil) F4FN(round, std::round) F4FN(trunc, std::trunc) F4FN(sin, std::sin) F4FN(cos, std::cos)
+F4FN(exp, std::exp) F4FN(log, std::log) F4FN(log2, std::log2) F4FN(sqrt, std::sqrt) F4FN(fabs, std::fabs) F4FN(abs, std::fabs) F4FN(tan, std::tan)
+inline float_4 fmin(float_4 a, float_4 b) { return float_4(_mm_min_ps(a.v, b.v)); }
+inline float_4 fmax(float_4 a, float_4 b) { return float_4(_mm_max_ps(a.v, b.v)); }
+inline float_4 clamp(float_4 x, float_4 a = 0.f, float_4 b = 1.f) { return fmin(fmax(x, a), b); }
+inline float_4 pow(float_4 a, float_4 b) { float_4 r; for (int i = 0; i < 4; i++) r.s[i] = std::pow(a.s[i], b.s[i]); return r; }
+inline float_4 pow(float_4 a, int b) { float_4 r = 1.f; for (int i = 0; i < b; i++) r = r * a; return r; }
+inline float_4 pow(float a, float_4 b) { return pow(float_4(a), b); }
+inline float_4 crossfade(float_4 a, float_4 b, float_4 p) { return a + (b - a) * p; }
+inline float_4 sgn(float_4 x) { return ifelse(x > 0.f, 1.f, ifelse(x < 0.f, -1.f, 0.f)); }
+inline float_4 rescale(float_4 x, float_4 a, float_4 b, float_4 c, float_4 d) { return c + (x - a) / (b - a) * (d - c); }
+inline float_4 exp2(float_4 a) { float_4 r; for (int i = 0; i < 4; i++) r.s[i] = std::exp2(a.s[i]); return r; }
+using std::floor; using std::ceil; using std::sin; using std::pow; using std::fmin; using std::fmax; using std::exp2; using std::fabs; using std::round;
+inline float clamp(float x, float a = 0.f, float b = 1.f) { return std::fmax(std::fmin(x, b), a); }
+inline float crossfade(float a, float b, float p) { return a + (b - a) * p; }
+inline int movemask(bool) { return 0; }
+}
+
+namespace dsp {
+static const float FREQ_C4 = 261.6256f; static const float FREQ_A4 = 440.f; static const float FREQ_SEMITONE = 1.0594630943592953f;
+template <typename T> T exp2_taylor5(T x) { return simd::exp2(x); }
+inline float exp2_taylor5(float x) { return std::exp2(x); }
+struct ClockDivider { uint32_t clock = 0, division = 1; void reset() { clock = 0; } void setDivision(uint32_t d) { division = d; }
+	uint32_t getDivision() { return division; } uint32_t getClock() { return clock; }
+	bool process() { if (++clock >= division) { clock = 0; return true; } return false; } };
+struct Timer { float time = 0.f; void reset() { time = 0.f; } float process(float dt) { time += dt; return time; } float getTime() { return time; } };
+template <typename T = float> struct TRCFilter { T c = 0.f, xstate[1] = {}, ystate[1] = {}; void setCutoff(T r) { c = 2.f / r; }
+	void process(T x) {} T lowpass() { return ystate[0]; } T highpass() { return x0 - ystate[0]; } T x0 = 0.f; };
+// Band-limited step from a Blackman windowed sinc over 2 * Z samples. Rack uses a minimum phase version,
+// the regression only needs the same correction for every revision under test.
+template <int Z, int O, typename T = float> struct MinBlepGenerator {
+	T buf[2 * Z] = {};
+	int pos = 0;
+	float impulse[2 * Z * O + 1];
+	MinBlepGenerator() {
+		const int n = 2 * Z * O + 1;
+		double sum = 0.;
+		for (int k = 0; k < n; k++) {
+			double t = (double) k / O - Z;
+			double sinc = t == 0. ? 1. : std::sin(M_PI * t) / (M_PI * t);
+			double w = 0.42 - 0.5 * std::cos(2 * M_PI * k / (n - 1)) + 0.08 * std::cos(4 * M_PI * k / (n - 1));
+			sum += sinc * w;
+			impulse[k] = sum;
+		}
+		for (int k = 0; k < n; k++)
+			impulse[k] /= sum;
+	}
+	void insertDiscontinuity(float p, T x) {
+		if (!(-1 < p && p <= 0))
+			return;
+		for (int j = 0; j < 2 * Z; j++) {
+			float index = ((float) j - p) * O;
+			int i = std::min((int) index, 2 * Z * O - 1);
+			float f = index - i;
+			float step = impulse[i] + f * (impulse[i + 1] - impulse[i]);
+			buf[(pos + j) % (2 * Z)] += x * (-1.f + step);
+		}
+	}
+	T process() { T v = buf[pos]; buf[pos] = T(0.f); pos = (pos + 1) % (2 * Z); return v; }
+};
+template <typename T, size_t S> struct RingBuffer { std::atomic<size_t> start{0}, end{0}; T data[S];
+	void push(T t) { size_t i = end % S; data[i] = t; end++; } T shift() { return data[start++ % S]; }
+	void clear() { start = end.load(); } bool empty() const { return start == end; } bool full() const { return end - start == S; } size_t size() const { return end - start; } };
+struct SlewLimiter { float out = 0.f; void setRiseFall(float, float) {} float process(float, float in) { out = in; return out; } };
+template <int N, typename T = float> struct Decimator { T process(T* in) { return in[0]; } T* startIncrementing() { return nullptr; } };
+template <typename T = float> struct TSchmittTrigger { T state = true; T process(T in, T lo = 0.f, T hi = 1.f) { T r = (in >= hi) & ~state; state = ifelse(in >= hi, T::mask(), ifelse(in <= lo, T::zero(), state)); return r; } T isHigh() { return state; } };
+template <> struct TSchmittTrigger<float> { bool state = true; bool process(float in, float lo = 0.f, float hi = 1.f) { bool r = in >= hi && !state; if (in >= hi) state = true; else if (in <= lo) state = false; return r; } bool isHigh() { return state; } };
+typedef TSchmittTrigger<float> SchmittTrigger;
+}
+
+namespace midi {
+struct Message { uint8_t size = 3; std::vector<uint8_t> bytes = std::vector<uint8_t>(3); int64_t frame = -1;
+	int getSize() const { return bytes.size(); } void setSize(int s) { bytes.resize(s); }
+	uint8_t getChannel() const { return bytes[0] & 0xf; } void setChannel(uint8_t c) { bytes[0] = (bytes[0] & 0xf0) | c; }
+	uint8_t getStatus() const { return bytes[0] >> 4; } void setStatus(uint8_t s) { bytes[0] = (bytes[0] & 0xf) | (s << 4); }
+	uint8_t getNote() const { return bytes[1]; } void setNote(uint8_t n) { bytes[1] = n; }
+	uint8_t getValue() const { return bytes[2]; } void setValue(uint8_t v) { bytes[2] = v; }
+	int64_t getFrame() const { return frame; } void setFrame(int64_t f) { frame = f; } };
+struct Driver { virtual ~Driver() {} virtual std::string getName() { return ""; }
+	virtual std::vector<int> getInputDeviceIds() { return {}; } virtual std::string getInputDeviceName(int) { return ""; }
+	virtual std::vector<int> getOutputDeviceIds() { return {}; } virtual std::string getOutputDeviceName(int) { return ""; } };
+std::vector<int> getDriverIds(); Driver* getDriver(int);
+struct Port { int driverId = -1, deviceId = -1, channel = -1; virtual ~Port() {} void setDriverId(int d) { driverId = d; } void setDeviceId(int d) { deviceId = d; }
+	int getDriverId() { return driverId; } int getDeviceId() { return deviceId; } void setChannel(int c) { channel = c; } int getChannel() { return channel; }
+	std::string getDeviceName(int) { return ""; } std::vector<int> getDeviceIds() { return {}; } void reset() {} json_t* toJson() const; void fromJson(json_t*); };
+struct Input : Port { virtual void onMessage(const Message&) {} };
+struct InputQueue : Input { bool tryPop(Message*, int64_t) { return false; } size_t size() { return 0; } };
+struct Output : Port { void sendMessage(const Message&) {} };
+}
+
+struct Plugin; struct Model;
+namespace engine {
+struct Param { float value = 0.f; float getValue() { return value; } void setValue(float v) { value = v; } };
+struct Light { float value = 0.f; void setBrightness(float b) { value = b; } float getBrightness() { return value; }
+	void setBrightnessSmooth(float, float) {} void setSmoothBrightness(float, float) {} };
+struct Port { float voltages[16] = {}; uint8_t channels = 0;
+	float getVoltage(int c = 0) { return voltages[c]; } void setVoltage(float v, int c = 0) { voltages[c] = v; }
+	float getPolyVoltage(int c) { return isMonophonic() ? getVoltage(0) : getVoltage(c); }
+	float getNormalVoltage(float n, int c = 0) { return isConnected() ? getVoltage(c) : n; }
+	float getNormalPolyVoltage(float n, int c) { return isConnected() ? getPolyVoltage(c) : n; }
+	template <typename T> T getVoltageSimd(int c) { return T::load(&voltages[c]); }
+	template <typename T> T getPolyVoltageSimd(int c) { return isMonophonic() ? T(getVoltage(0)) : getVoltageSimd<T>(c); }
+	template <typename T> T getNormalPolyVoltageSimd(T n, int c) { return isConnected() ? getPolyVoltageSimd<T>(c) : n; }
+	template <typename T> void setVoltageSimd(T v, int c) { v.store(&voltages[c]); }
+	int getChannels() { return channels; } void setChannels(int c) { channels = c; }
+	bool isConnected() { return channels > 0; } bool isMonophonic() { return channels == 1; } bool isPolyphonic() { return channels > 1; } };
+struct Input : Port {}; struct Output : Port {};
+struct ParamQuantity { bool randomizeEnabled = true; bool snapEnabled = false; std::string name; std::string unit; float getValue(); void setValue(float); virtual ~ParamQuantity() {} };
+struct SwitchQuantity : ParamQuantity {};
+struct PortInfo { std::string name; }; struct LightInfo { std::string name; };
+struct Module {
+	int64_t id = -1; Model* model = nullptr;
+	struct Expander { int64_t moduleId = -1; Module* module = nullptr; void* producerMessage = nullptr; void* consumerMessage = nullptr; bool messageFlipRequested = false; };
+	Expander leftExpander, rightExpander;
+	std::vector<Param> params; std::vector<Input> inputs; std::vector<Output> outputs; std::vector<Light> lights;
+	struct ProcessArgs { float sampleRate; float sampleTime; int64_t frame; };
+	struct SampleRateChangeEvent { float sampleRate; float sampleTime; };
+	struct ResetEvent {}; struct RandomizeEvent {}; struct AddEvent {}; struct RemoveEvent {};
+	virtual ~Module() {}
+	void config(int p, int i, int o, int l = 0) { params.resize(p); inputs.resize(i); outputs.resize(o); lights.resize(l); }
+	// Like Rack, params start at their default value
+	template <class TParamQuantity = ParamQuantity> TParamQuantity* configParam(int id, float, float, float def, std::string = "", std::string = "", float = 0.f, float = 1.f, float = 0.f) { params[id].value = def; return nullptr; }
+	template <class TSwitchQuantity = SwitchQuantity> TSwitchQuantity* configSwitch(int id, float, float, float def, std::string = "", std::vector<std::string> = {}) { params[id].value = def; return nullptr; }
+	template <class TSwitchQuantity = SwitchQuantity> TSwitchQuantity* configButton(int, std::string = "") { return nullptr; }
+	PortInfo* configInput(int, std::string = "") { return nullptr; } PortInfo* configOutput(int, std::string = "") { return nullptr; }
+	LightInfo* configLight(int, std::string = "") { return nullptr; }
+	void configBypass(int, int) {}
+	ParamQuantity* getParamQuantity(int);
+	virtual void process(const ProcessArgs&) {} virtual void step() {}
+	virtual json_t* dataToJson() { return nullptr; } virtual void dataFromJson(json_t*) {}
+	virtual void onSampleRateChange(const SampleRateChangeEvent&) {} virtual void onSampleRateChange() {}
+	virtual void onReset(const ResetEvent&) {} virtual void onReset() {} virtual void onRandomize() {}
+	virtual void onAdd(const AddEvent&) {} virtual void onRemove(const RemoveEvent&) {}
+};
+}
+using engine::Module;
+
+namespace widget { struct Widget { math::Rect box; Widget* parent = nullptr; virtual ~Widget() {}
+	struct DrawArgs { NVGcontext* vg; Rect clipBox; };
+	virtual void step() {} virtual void draw(const DrawArgs&) {} virtual void drawLayer(const DrawArgs&, int) {}
+	void addChild(Widget*) {} template <class T> T* getAncestorOfType() { return nullptr; } }; }
+using widget::Widget;
+struct Font { int handle; }; struct Window { std::shared_ptr<Font> loadFont(const std::string&); };
+struct Context { Window* window; Context* operator->() { return this; } }; extern Context* APP_;
+#define APP APP_
+struct Svg { static std::shared_ptr<Svg> load(const std::string&); };
+namespace event { struct Button { int action, button; }; }
+namespace color { static const NVGcolor BLACK_TRANSPARENT = {0, 0, 0, 0}; static const NVGcolor BLACK = {0,0,0,1}; }
+static const NVGcolor SCHEME_YELLOW = {1,1,0,1}, SCHEME_RED = {1,0,0,1}, SCHEME_BLUE = {0,0,1,1}, SCHEME_BLACK = {0,0,0,1}, SCHEME_GREEN = {0,1,0,1}, SCHEME_WHITE = {1,1,1,1};
+namespace ui { struct MenuEntry : Widget {}; struct MenuItem : MenuEntry { std::string text, rightText; bool disabled = false; }; struct MenuSeparator : MenuEntry {};
+	struct MenuLabel : MenuEntry { std::string text; }; struct Menu : Widget {}; }
+using ui::Menu; using ui::MenuItem; using ui::MenuSeparator; using ui::MenuLabel;
+namespace app {
+	struct ModuleWidget : Widget { void setModule(engine::Module*) {} void setPanel(Widget*) {} template <class T = engine::Module> T* getModule() { return nullptr; }
+		engine::Module* module = nullptr; virtual void appendContextMenu(Menu*) {} void addParam(Widget*) {} void addInput(Widget*) {} void addOutput(Widget*) {} };
+	struct ParamWidget : Widget {}; struct PortWidget : Widget {}; struct SvgSwitch : ParamWidget { bool momentary = false; void addFrame(std::shared_ptr<Svg>) {} };
+	struct ModuleLightWidget : Widget { NVGcolor borderColor, bgColor; void addBaseColor(NVGcolor) {} };
+}
+namespace app { void appendMidiMenu(ui::Menu* menu, midi::Port* port); }
+using app::appendMidiMenu;
+using app::ModuleWidget;
+namespace componentlibrary {
+	struct GrayModuleLightWidget : app::ModuleLightWidget {};
+	template <typename T = GrayModuleLightWidget> struct TSvgLight : T {};
+	template <typename T = GrayModuleLightWidget> struct TRedGreenBlueLight : T {}; template <typename T = GrayModuleLightWidget> struct TGreenLight : T {};
+	template <typename T = GrayModuleLightWidget> struct TWhiteLight : T {}; template <typename T = GrayModuleLightWidget> struct TYellowLight : T {};
+	using RedGreenBlueLight = TRedGreenBlueLight<>; using GreenLight = TGreenLight<>; using WhiteLight = TWhiteLight<>; using YellowLight = TYellowLight<>;
+	template <typename T> struct SmallLight : T {}; template <typename T> struct MediumLight : T {}; template <typename T> struct MediumSimpleLight : T {};
+	template <typename T> struct VCVLightLatch : app::SvgSwitch {}; template <typename T> struct VCVLightBezel : app::SvgSwitch {};
+	struct ThemedScrew : Widget {}; struct RoundHugeBlackKnob : app::ParamWidget {}; struct RoundBlackKnob : app::ParamWidget {}; struct Trimpot : app::ParamWidget {};
+	struct ThemedPJ301MPort : app::PortWidget {}; struct VCVBezel : app::SvgSwitch {};
+}
+using namespace componentlibrary;
+namespace asset { std::string plugin(Plugin*, const std::string&); }
+struct Model {}; struct Plugin { void addModel(Model*) {} };
+template <class TModule, class TModuleWidget> Model* createModel(std::string) { return nullptr; }
+template <class TWidget> TWidget* createWidget(Vec) { return new TWidget; }
+template <class TWidget> TWidget* createWidgetCentered(Vec) { return new TWidget; }
+Widget* createPanel(std::string);
+template <class TParamWidget> TParamWidget* createParamCentered(Vec, engine::Module*, int) { return new TParamWidget; }
+template <class TParamWidget> TParamWidget* createParam(Vec, engine::Module*, int) { return new TParamWidget; }
+template <class TParamWidget> TParamWidget* createLightParamCentered(Vec, engine::Module*, int, int) { return new TParamWidget; }
+template <class TPortWidget> TPortWidget* createInputCentered(Vec, engine::Module*, int) { return new TPortWidget; }
+template <class TPortWidget> TPortWidget* createOutputCentered(Vec, engine::Module*, int) { return new TPortWidget; }
+template <class TLight> TLight* createLightCentered(Vec, engine::Module*, int) { return new TLight; }
+MenuItem* createIndexSubmenuItem(std::string, std::vector<std::string>, std::function<size_t()>, std::function<void(size_t)>, bool = false);
+MenuItem* createBoolPtrMenuItem(std::string, std::string, bool*);
+template <typename T> MenuItem* createBoolPtrMenuItem(std::string, std::string, T*);
+MenuItem* createBoolMenuItem(std::string, std::string, std::function<bool()>, std::function<void(bool)>, bool = false);
+MenuItem* createMenuItem(std::string, std::string = "", std::function<void()> = {}, bool = false);
+MenuLabel* createMenuLabel(std::string);
+MenuItem* createSubmenuItem(std::string, std::string, std::function<void(Menu*)>, bool = false);
+namespace system { double getTime(); int64_t getNanoseconds(); }
+namespace random { float uniform(); float normal(); }
+}
@@ -0,0 +1,36 @@
+// Definitions for the no-op parts of the Rack shim
+#include "rack.hpp"
+
+rack::Plugin* pluginInstance = nullptr;
+json_t* json_object() { return nullptr; } json_t* json_array() { return nullptr; } json_t* json_integer(long long) { return nullptr; } json_t* json_real(double) { return nullptr; }
+json_t* json_boolean(bool) { return nullptr; } json_t* json_true() { return nullptr; } json_t* json_false() { return nullptr; } json_t* json_string(const char*) { return nullptr; }
+int json_object_set_new(json_t*, const char*, json_t*) { return 0; } json_t* json_object_get(const json_t*, const char*) { return nullptr; }
+int json_array_append_new(json_t*, json_t*) { return 0; } json_t* json_array_get(const json_t*, size_t) { return nullptr; } size_t json_array_size(const json_t*) { return 0; }
+long long json_integer_value(const json_t*) { return 0; } double json_number_value(const json_t*) { return 0; } double json_real_value(const json_t*) { return 0; }
+bool json_is_array(const json_t*) { return false; } bool json_is_integer(const json_t*) { return false; } bool json_is_number(const json_t*) { return false; } bool json_is_object(const json_t*) { return false; }
+bool json_is_true(const json_t*) { return false; } bool json_boolean_value(const json_t*) { return false; } bool json_is_boolean(const json_t*) { return false; } const char* json_string_value(const json_t*) { return ""; }
+NVGcolor nvgRGB(unsigned char, unsigned char, unsigned char) { return {}; } NVGcolor nvgRGBA(unsigned char, unsigned char, unsigned char, unsigned char) { return {}; } NVGcolor nvgRGBf(float, float, float) { return {}; }
+void nvgBeginPath(NVGcontext*) {} void nvgClosePath(NVGcontext*) {} void nvgFill(NVGcontext*) {} void nvgStroke(NVGcontext*) {}
+void nvgFillColor(NVGcontext*, NVGcolor) {} void nvgStrokeColor(NVGcontext*, NVGcolor) {} void nvgFontFaceId(NVGcontext*, int) {} void nvgFontSize(NVGcontext*, float) {}
+void nvgLineTo(NVGcontext*, float, float) {} void nvgMoveTo(NVGcontext*, float, float) {} void nvgRect(NVGcontext*, float, float, float, float) {}
+void nvgRoundedRect(NVGcontext*, float, float, float, float, float) {} float nvgText(NVGcontext*, float, float, const char*, const char*) { return 0; }
+void nvgTextAlign(NVGcontext*, int) {} void nvgTextLetterSpacing(NVGcontext*, float) {}
+namespace rack {
+namespace string { std::string f(const char*, ...) { return ""; } }
+namespace app { void appendMidiMenu(ui::Menu*, midi::Port*) {} }
+namespace midi { std::vector<int> getDriverIds() { return {}; } Driver* getDriver(int) { return nullptr; } json_t* Port::toJson() const { return nullptr; } void Port::fromJson(json_t*) {} }
+namespace engine { ParamQuantity* Module::getParamQuantity(int) { static ParamQuantity q; return &q; } float ParamQuantity::getValue() { return 0; } void ParamQuantity::setValue(float) {} }
+std::shared_ptr<Font> Window::loadFont(const std::string&) { return nullptr; } Context* APP_ = nullptr;
+std::shared_ptr<Svg> Svg::load(const std::string&) { return nullptr; }
+namespace asset { std::string plugin(Plugin*, const std::string&) { return ""; } }
+Widget* createPanel(std::string) { return nullptr; }
+MenuItem* createIndexSubmenuItem(std::string, std::vector<std::string>, std::function<size_t()>, std::function<void(size_t)>, bool) { return nullptr; }
+MenuItem* createBoolPtrMenuItem(std::string, std::string, bool*) { return nullptr; }
+MenuItem* createBoolMenuItem(std::string, std::string, std::function<bool()>, std::function<void(bool)>, bool) { return nullptr; }
+MenuItem* createMenuItem(std::string, std::string, std::function<void()>, bool) { return nullptr; }
+MenuLabel* createMenuLabel(std::string) { return nullptr; }
+MenuItem* createSubmenuItem(std::string, std::string, std::function<void(Menu*)>, bool) { return nullptr; }
+namespace system { double getTime() { return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+	int64_t getNanoseconds() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); } }
+namespace random { float uniform() { return 0.5f; } float normal() { return 0.f; } }
+}